@@ -0,0 +1,184 @@
+#include "devices/lapic.h"
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include "devices/pit.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/mmu.h"
+#include "threads/pte.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+/* Local APIC, used here as a per-CPU timer.
+   See [IA32-v3a] chapter 10 "Advanced Programmable Interrupt
+   Controller (APIC)" for hardware details. */
+
+/* Local APIC registers, as byte offsets from the APIC base. */
+#define LAPIC_ID        0x020   /* Local APIC ID. */
+#define LAPIC_TPR       0x080   /* Task priority. */
+#define LAPIC_EOI       0x0b0   /* End of interrupt. */
+#define LAPIC_SVR       0x0f0   /* Spurious interrupt vector. */
+#define LAPIC_LVT_TIMER 0x320   /* LVT timer. */
+#define LAPIC_LVT_LINT0 0x350   /* LVT LINT0. */
+#define LAPIC_LVT_LINT1 0x360   /* LVT LINT1. */
+#define LAPIC_TIMER_ICR 0x380   /* Timer initial count. */
+#define LAPIC_TIMER_CCR 0x390   /* Timer current count. */
+#define LAPIC_TIMER_DCR 0x3e0   /* Timer divide configuration. */
+
+/* Register bits. */
+#define SVR_ENABLE       0x100      /* APIC software enable. */
+#define LVT_MASKED       0x10000    /* Interrupt masked. */
+#define LVT_DM_NMI       0x400      /* Delivery mode: NMI. */
+#define LVT_DM_EXTINT    0x700      /* Delivery mode: ExtINT. */
+#define LVT_TIMER_PERIODIC 0x20000  /* Timer mode: periodic. */
+#define DCR_DIV_16       0x3        /* Divide bus clock by 16. */
+
+/* IA32_APIC_BASE model specific register. */
+#define MSR_APIC_BASE    0x1b
+#define APIC_BASE_ENABLE (1 << 11)  /* APIC global enable. */
+#define APIC_BASE_ADDR   0xfffff000UL
+
+/* CPUID.01H:EDX bit reporting an on-chip APIC. */
+#define CPUID_1_EDX_APIC (1 << 9)
+
+/* How long to count the APIC timer against the PIT, in us. */
+#define CALIBRATE_US 50000
+
+/* Kernel virtual address of the APIC registers, or a null pointer
+   if the CPU has no usable local APIC. */
+static volatile uint8_t *lapic_base;
+
+/* APIC timer counts per second, after the divider. */
+static uint64_t lapic_timer_hz;
+
+static intr_handler_func lapic_spurious;
+
+static inline uint32_t
+lapic_read (unsigned reg) {
+	return *(volatile uint32_t *) (lapic_base + reg);
+}
+
+static inline void
+lapic_write (unsigned reg, uint32_t value) {
+	*(volatile uint32_t *) (lapic_base + reg) = value;
+	(void) lapic_read (LAPIC_ID);   /* Wait for the write to land. */
+}
+
+/* Maps the local APIC's register page into the kernel address
+   space, enables the APIC, and keeps the 8259A PICs reachable
+   through LINT0 ("virtual wire" mode).  The timer is left
+   masked.  Returns false, leaving the APIC untouched, if the CPU
+   does not have one. */
+bool
+lapic_init (void) {
+	uint32_t eax, ebx, ecx, edx;
+	uint64_t apic_base, pa;
+	uint64_t *pte;
+
+	cpuid (1, 0, &eax, &ebx, &ecx, &edx);
+	if (!(edx & CPUID_1_EDX_APIC))
+		return false;
+
+	apic_base = read_msr (MSR_APIC_BASE);
+	pa = apic_base & APIC_BASE_ADDR;
+
+	/* The register page lies outside of RAM, so the boot-time
+	   direct map usually does not cover it.  Map it uncached. */
+	pte = pml4e_walk (base_pml4, (uint64_t) ptov (pa), 1);
+	if (pte == NULL)
+		return false;
+	*pte = pa | PTE_P | PTE_W | PTE_PCD | PTE_PWT;
+	invlpg ((uint64_t) ptov (pa));
+	lapic_base = ptov (pa);
+
+	write_msr (MSR_APIC_BASE, apic_base | APIC_BASE_ENABLE);
+	intr_register_int (LAPIC_SPURIOUS_VEC, 0, INTR_OFF, lapic_spurious,
+			"LAPIC Spurious Interrupt");
+
+	lapic_write (LAPIC_SVR, SVR_ENABLE | LAPIC_SPURIOUS_VEC);
+	lapic_write (LAPIC_LVT_LINT0, LVT_DM_EXTINT);
+	lapic_write (LAPIC_LVT_LINT1, LVT_DM_NMI);
+	lapic_write (LAPIC_LVT_TIMER, LVT_MASKED | LAPIC_TIMER_VEC);
+	lapic_write (LAPIC_TIMER_DCR, DCR_DIV_16);
+	lapic_write (LAPIC_TPR, 0);
+	return true;
+}
+
+/* Returns true if lapic_init() found and enabled a local APIC. */
+bool
+lapic_present (void) {
+	return lapic_base != NULL;
+}
+
+/* Acknowledges the interrupt currently being serviced. */
+void
+lapic_eoi (void) {
+	ASSERT (lapic_present ());
+	lapic_write (LAPIC_EOI, 0);
+}
+
+/* Measures the APIC timer's rate against a PIT one-shot and
+   returns it, in counts per second.  Must be called with
+   interrupts off, before the timer is started. */
+uint64_t
+lapic_timer_calibrate (void) {
+	uint32_t elapsed;
+
+	ASSERT (lapic_present ());
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	lapic_write (LAPIC_LVT_TIMER, LVT_MASKED | LAPIC_TIMER_VEC);
+	lapic_write (LAPIC_TIMER_ICR, 0xffffffff);
+	pit_delay (CALIBRATE_US);
+	elapsed = 0xffffffff - lapic_read (LAPIC_TIMER_CCR);
+	lapic_write (LAPIC_TIMER_ICR, 0);
+
+	lapic_timer_hz = (uint64_t) elapsed * 1000000 / CALIBRATE_US;
+	return lapic_timer_hz;
+}
+
+/* Starts the timer interrupting FREQUENCY times per second on
+   LAPIC_TIMER_VEC. */
+void
+lapic_timer_periodic (unsigned frequency) {
+	ASSERT (lapic_timer_hz != 0);
+	ASSERT (frequency > 0);
+
+	lapic_write (LAPIC_LVT_TIMER, LVT_TIMER_PERIODIC | LAPIC_TIMER_VEC);
+	lapic_write (LAPIC_TIMER_ICR, (lapic_timer_hz + frequency / 2) / frequency);
+}
+
+/* Arms the timer to interrupt once on LAPIC_TIMER_VEC, NS
+   nanoseconds from now, replacing any periodic or pending
+   one-shot setting.  The deadline is rounded up to the timer's
+   resolution and clamped to the longest interval the counter can
+   express. */
+void
+lapic_timer_oneshot (uint64_t ns) {
+	uint64_t count;
+
+	ASSERT (lapic_timer_hz != 0);
+
+	count = DIV_ROUND_UP (ns * (lapic_timer_hz / 1000), 1000000);
+	if (count == 0)
+		count = 1;
+	else if (count > 0xffffffff)
+		count = 0xffffffff;
+
+	lapic_write (LAPIC_LVT_TIMER, LAPIC_TIMER_VEC);
+	lapic_write (LAPIC_TIMER_ICR, count);
+}
+
+/* Stops the timer and masks its interrupt. */
+void
+lapic_timer_stop (void) {
+	lapic_write (LAPIC_LVT_TIMER, LVT_MASKED | LAPIC_TIMER_VEC);
+	lapic_write (LAPIC_TIMER_ICR, 0);
+}
+
+/* Spurious interrupts need no acknowledgement; just drop them.
+   See [IA32-v3a] 10.9 "Spurious Interrupt". */
+static void
+lapic_spurious (struct intr_frame *f UNUSED) {
+}
@@ -3,12 +3,16 @@
 #include <inttypes.h>
 #include <round.h>
 #include <stdio.h>
+#include "devices/lapic.h"
+#include "devices/pit.h"
 #include "threads/interrupt.h"
-#include "threads/io.h"
 #include "threads/synch.h"
+#include "threads/profile.h"
 #include "threads/thread.h"
+#include "intrinsic.h"
 
-/* See [8254] for hardware details of the 8254 timer chip. */
+/* See [8254] for hardware details of the 8254 timer chip, and
+   lapic.c for the local APIC timer that replaces it when present. */
 
 #if TIMER_FREQ < 19
 #error 8254 timer requires TIMER_FREQ >= 19
@@ -20,32 +24,56 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
-/* Number of loops per timer tick.
-   Initialized by timer_calibrate(). */
+/* Nanoseconds per timer tick. */
+#define NS_PER_TICK (1000000000 / TIMER_FREQ)
+
+/* How long to count the TSC against the PIT, in us. */
+#define TSC_CALIBRATE_US 50000
+
+/* Time-stamp counter frequency in kHz, or 0 if the TSC is not
+   usable as a clock.  Initialized by timer_calibrate(). */
+static uint64_t tsc_khz;
+
+/* TSC value and timer_ns() value when the TSC was calibrated.
+   timer_ns() counts TSC time from this point on, so that it
+   continues from the tick-based time it returned before. */
+static uint64_t tsc_base;
+static int64_t ns_base;
+
+/* Number of loops per timer tick.  Only used, and only
+   initialized by timer_calibrate(), when there is no TSC. */
 static unsigned loops_per_tick;
 
 static intr_handler_func timer_interrupt;
+static bool tsc_calibrate (void);
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
 
-/* Sets up the 8254 Programmable Interval Timer (PIT) to
-   interrupt PIT_FREQ times per second, and registers the
-   corresponding interrupt. */
+/* Sets up the scheduling clock to interrupt TIMER_FREQ times per
+   second, and registers the corresponding interrupt.
+
+   The local APIC timer is preferred: it is per-CPU and cheap to
+   reprogram.  Its rate is not architecturally defined, so it is
+   first calibrated against the 8254 Programmable Interval Timer
+   (PIT).  Without a local APIC, the PIT itself drives the clock. */
 void
 timer_init (void) {
-	/* 8254 input frequency divided by TIMER_FREQ, rounded to
-	   nearest. */
-	uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
-
-	outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
-	outb (0x40, count & 0xff);
-	outb (0x40, count >> 8);
+	if (lapic_present ()) {
+		uint64_t hz = lapic_timer_calibrate ();
 
-	intr_register_ext (0x20, timer_interrupt, "8254 Timer");
+		printf ("Local APIC timer: %'"PRIu64" counts/s.\n", hz);
+		intr_register_ext (LAPIC_TIMER_VEC, timer_interrupt, "LAPIC Timer");
+		intr_mask_ext (0x20);
+		lapic_timer_periodic (TIMER_FREQ);
+	} else {
+		pit_configure_channel (0, 2, TIMER_FREQ);
+		intr_register_ext (0x20, timer_interrupt, "8254 Timer");
+	}
 }
 
-/* Calibrates loops_per_tick, used to implement brief delays. */
+/* Calibrates the clock used to implement brief delays: the TSC
+   if the CPU has one, otherwise loops_per_tick. */
 void
 timer_calibrate (void) {
 	unsigned high_bit, test_bit;
@@ -53,6 +81,9 @@ timer_calibrate (void) {
 	ASSERT (intr_get_level () == INTR_ON);
 	printf ("Calibrating timer...  ");
 
+	if (tsc_calibrate ())
+		return;
+
 	/* Approximate loops_per_tick as the largest power-of-two
 	   still less than one timer tick. */
 	loops_per_tick = 1u << 10;
@@ -87,6 +118,29 @@ timer_elapsed (int64_t then) {
 	return timer_ticks () - then;
 }
 
+/* Returns the number of nanoseconds since the OS booted, read
+   from the TSC.  Before timer_calibrate(), or on CPUs without a
+   usable TSC, falls back to timer tick resolution.  The result
+   never goes backward, even across calibration. */
+int64_t
+timer_ns (void) {
+	if (tsc_khz == 0)
+		return timer_ticks () * NS_PER_TICK;
+	return ns_base + timer_cycles_to_ns (rdtsc () - tsc_base);
+}
+
+/* Converts CYCLES, a count of TSC cycles, into nanoseconds.
+   Returns 0 if the TSC has not been calibrated. */
+int64_t
+timer_cycles_to_ns (uint64_t cycles) {
+	if (tsc_khz == 0)
+		return 0;
+
+	/* Split the division so that the multiplication cannot
+	   overflow, however long the machine has been up. */
+	return cycles / tsc_khz * 1000000 + cycles % tsc_khz * 1000000 / tsc_khz;
+}
+
 /* Suspends execution for approximately TICKS timer ticks. */
 /* project1 alarm clock */
 void
@@ -124,12 +178,58 @@ timer_print_stats (void) {
 /* Timer interrupt handler. */
 /* project1 alarm clock */
 static void
-timer_interrupt (struct intr_frame *args UNUSED) {
+timer_interrupt (struct intr_frame *args) {
 	ticks++;
+	if (profile_enabled)
+		profile_sample (args);
 	thread_tick ();
 	thread_awake(ticks);
 }
 
+/* Measures the TSC frequency against a PIT one-shot, if the CPU
+   has a TSC, and reports the result.  Returns false if there is
+   no TSC, in which case the caller must fall back to calibrating
+   loops_per_tick.
+
+   Only an invariant TSC is guaranteed to tick at a constant rate
+   across P- and C-state changes; others are still used, since
+   most hypervisors present a constant-rate TSC without
+   advertising it, but the boot message says so. */
+static bool
+tsc_calibrate (void) {
+	uint32_t eax, ebx, ecx, edx;
+	bool invariant = false;
+	uint64_t start, end, khz;
+
+	cpuid (1, 0, &eax, &ebx, &ecx, &edx);
+	if (!(edx & (1 << 4)))          /* CPUID.01H:EDX.TSC */
+		return false;
+
+	cpuid (0x80000000, 0, &eax, &ebx, &ecx, &edx);
+	if (eax >= 0x80000007) {
+		cpuid (0x80000007, 0, &eax, &ebx, &ecx, &edx);
+		invariant = (edx & (1 << 8)) != 0;    /* Invariant TSC. */
+	}
+
+	start = rdtsc ();
+	pit_delay (TSC_CALIBRATE_US);
+	end = rdtsc ();
+	if (end <= start)
+		return false;
+
+	/* Set the base before TSC_KHZ, which switches timer_ns()
+	   over to the TSC.  No earlier tick-based reading can exceed
+	   NS_BASE, so timer_ns() stays monotonic. */
+	khz = (end - start) * 1000 / TSC_CALIBRATE_US;
+	ns_base = timer_ticks () * NS_PER_TICK;
+	tsc_base = rdtsc ();
+	barrier ();
+	tsc_khz = khz;
+	printf ("%'"PRIu64" kHz %sTSC.\n", tsc_khz,
+			invariant ? "invariant " : "");
+	return true;
+}
+
 /* Returns true if LOOPS iterations waits for more than one timer
    tick, otherwise false. */
 static bool
@@ -171,18 +271,38 @@ real_time_sleep (int64_t num, int32_t denom) {
 	   1 s / TIMER_FREQ ticks
 	   */
 	int64_t ticks = num * TIMER_FREQ / denom;
+	int64_t deadline;
 
 	ASSERT (intr_get_level () == INTR_ON);
-	if (ticks > 0) {
-		/* We're waiting for at least one full timer tick.  Use
-		   timer_sleep() because it will yield the CPU to other
-		   processes. */
-		timer_sleep (ticks);
-	} else {
-		/* Otherwise, use a busy-wait loop for more accurate
-		   sub-tick timing.  We scale the numerator and denominator
-		   down by 1000 to avoid the possibility of overflow. */
-		ASSERT (denom % 1000 == 0);
-		busy_wait (loops_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000));
+	ASSERT (denom % 1000 == 0);
+	if (tsc_khz == 0) {
+		if (ticks > 0) {
+			/* We're waiting for at least one full timer tick.  Use
+			   timer_sleep() because it will yield the CPU to other
+			   processes. */
+			timer_sleep (ticks);
+		} else {
+			/* Otherwise, use a busy-wait loop for more accurate
+			   sub-tick timing.  We scale the numerator and
+			   denominator down by 1000 to avoid the possibility of
+			   overflow. */
+			busy_wait (loops_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000));
+		}
+		return;
+	}
+
+	/* With a TSC we know exactly when to stop.  Block on the timer
+	   while at least one whole tick remains, then spin on the TSC
+	   for the sub-tick remainder. */
+	deadline = timer_ns () + num * (1000000000 / denom);
+	for (;;) {
+		int64_t left = deadline - timer_ns ();
+
+		if (left <= 0)
+			break;
+		if (left >= NS_PER_TICK)
+			timer_sleep (left / NS_PER_TICK);
+		else
+			barrier ();
 	}
 }
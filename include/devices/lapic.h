@@ -0,0 +1,22 @@
+#ifndef DEVICES_LAPIC_H
+#define DEVICES_LAPIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Interrupt vectors owned by the local APIC.  They sit just above
+   the 8259A's range (0x20...0x2f), so that interrupt.c can treat
+   them as external interrupts. */
+#define LAPIC_TIMER_VEC    0x30     /* Local APIC timer. */
+#define LAPIC_SPURIOUS_VEC 0xff     /* Spurious interrupt. */
+
+bool lapic_init (void);
+bool lapic_present (void);
+void lapic_eoi (void);
+
+uint64_t lapic_timer_calibrate (void);
+void lapic_timer_periodic (unsigned frequency);
+void lapic_timer_oneshot (uint64_t ns);
+void lapic_timer_stop (void);
+
+#endif /* devices/lapic.h */
@@ -0,0 +1,12 @@
+#ifndef DEVICES_PIT_H
+#define DEVICES_PIT_H
+
+#include <stdint.h>
+
+/* 8254 input frequency, in Hz. */
+#define PIT_HZ 1193180
+
+void pit_configure_channel (int channel, int mode, int frequency);
+void pit_delay (unsigned us);
+
+#endif /* devices/pit.h */
@@ -12,6 +12,8 @@ void timer_calibrate (void);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
+int64_t timer_ns (void);
+int64_t timer_cycles_to_ns (uint64_t cycles);
 
 void timer_sleep (int64_t ticks);
 void timer_msleep (int64_t milliseconds);
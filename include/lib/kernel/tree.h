@@ -0,0 +1,73 @@
+#ifndef __LIB_KERNEL_TREE_H
+#define __LIB_KERNEL_TREE_H
+
+/* Ordered tree.
+ *
+ * This is a red-black tree: a binary search tree whose depth is
+ * at most twice the logarithm of its size, so that insertion,
+ * deletion and search all take O(log n) time.  Unlike a hash
+ * table, it keeps its elements in order, which allows searching
+ * for the greatest element not above a given one, e.g. the
+ * region of memory that contains an address.
+ *
+ * Like lists and hash tables, the tree does not use dynamic
+ * allocation.  Each structure that can be in a tree embeds a
+ * struct tree_elem member, and the tree_entry macro converts a
+ * struct tree_elem back to the structure that contains it.
+ * Refer to lib/kernel/list.h for a detailed explanation.
+ *
+ * A tree may not contain two equal elements. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Tree element. */
+struct tree_elem {
+	struct tree_elem *parent;   /* Parent, or null at the root. */
+	struct tree_elem *left;     /* Lesser elements, or null. */
+	struct tree_elem *right;    /* Greater elements, or null. */
+	bool red;                   /* Red or black? */
+};
+
+/* Converts pointer to tree element TREE_ELEM into a pointer to
+ * the structure that TREE_ELEM is embedded inside.  Supply the
+ * name of the outer structure STRUCT and the member name MEMBER
+ * of the tree element. */
+#define tree_entry(TREE_ELEM, STRUCT, MEMBER)           \
+	((STRUCT *) ((uint8_t *) &(TREE_ELEM)->parent   \
+		- offsetof (STRUCT, MEMBER.parent)))
+
+/* Compares the value of two tree elements A and B, given
+ * auxiliary data AUX.  Returns true if A is less than B, or
+ * false if A is greater than or equal to B. */
+typedef bool tree_less_func (const struct tree_elem *a,
+		const struct tree_elem *b,
+		void *aux);
+
+/* Tree. */
+struct tree {
+	struct tree_elem *root;     /* Root element, or null if empty. */
+	size_t elem_cnt;            /* Number of elements in tree. */
+	tree_less_func *less;       /* Comparison function. */
+	void *aux;                  /* Auxiliary data for `less'. */
+};
+
+/* Basic life cycle. */
+void tree_init (struct tree *, tree_less_func *, void *aux);
+
+/* Search, insertion, deletion. */
+struct tree_elem *tree_insert (struct tree *, struct tree_elem *);
+struct tree_elem *tree_find (struct tree *, const struct tree_elem *);
+struct tree_elem *tree_floor (struct tree *, const struct tree_elem *);
+void tree_remove (struct tree *, struct tree_elem *);
+
+/* Traversal, in ascending order. */
+struct tree_elem *tree_first (struct tree *);
+struct tree_elem *tree_next (struct tree_elem *);
+
+/* Information. */
+size_t tree_size (struct tree *);
+bool tree_empty (struct tree *);
+
+#endif /* lib/kernel/tree.h */
@@ -20,6 +20,7 @@ void *memset (void *, int, size_t);
 size_t strlen (const char *);
 
 /* Extensions. */
+void string_init (void);
 size_t strlcpy (char *, const char *, size_t);
 size_t strlcat (char *, const char *, size_t);
 char *strtok_r (char *, const char *, char **);
@@ -36,6 +36,18 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* User-space synchronization. */
+	SYS_FUTEX,                  /* Wait on or wake a user address. */
+	SYS_THREAD_CREATE,          /* Start a thread in this process. */
+	SYS_THREAD_JOIN,            /* Wait for a thread to exit. */
+	SYS_THREAD_EXIT,            /* Terminate the calling thread. */
+};
+
+/* Operations for SYS_FUTEX. */
+enum {
+	FUTEX_WAIT,                 /* Sleep if *addr still equals val. */
+	FUTEX_WAKE,                 /* Wake up to val sleepers on addr. */
 };
 
 #endif /* lib/syscall-nr.h */
@@ -0,0 +1,32 @@
+#ifndef __LIB_USER_SYNCH_H
+#define __LIB_USER_SYNCH_H
+
+#include <stdbool.h>
+
+/* Mutex.  Zero-initialized is unlocked. */
+struct mutex {
+	int state;                  /* 0: unlocked, 1: locked,
+	                               2: locked with possible waiters. */
+};
+
+#define MUTEX_INITIALIZER { 0 }
+
+void mutex_init (struct mutex *);
+void mutex_lock (struct mutex *);
+bool mutex_trylock (struct mutex *);
+void mutex_unlock (struct mutex *);
+
+/* Condition variable.  Zero-initialized has no waiters. */
+struct condvar {
+	int seq;                    /* Bumped by every signal. */
+	int waiters;                /* Threads in condvar_wait(). */
+};
+
+#define CONDVAR_INITIALIZER { 0, 0 }
+
+void condvar_init (struct condvar *);
+void condvar_wait (struct condvar *, struct mutex *);
+void condvar_signal (struct condvar *, struct mutex *);
+void condvar_broadcast (struct condvar *, struct mutex *);
+
+#endif /* lib/user/synch.h */
@@ -50,6 +50,17 @@ bool isdir (int fd);
 int inumber (int fd);
 int symlink (const char* target, const char* linkpath);
 
+/* User-space synchronization. */
+int futex (int *addr, int op, int val);
+
+/* Threads sharing the process's address space. */
+typedef int tid_t;
+#define TID_ERROR ((tid_t) -1)
+
+tid_t uthread_create (void (*function) (void *), void *aux);
+int uthread_join (tid_t);
+void uthread_exit (int status) NO_RETURN;
+
 static inline void* get_phys_addr (void *user_addr) {
 	void* pa;
 	asm volatile ("movq %0, %%rax" ::"r"(user_addr));
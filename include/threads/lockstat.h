@@ -0,0 +1,21 @@
+#ifndef THREADS_LOCKSTAT_H
+#define THREADS_LOCKSTAT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Contention statistics for every lock initialized under one
+   name.  Opaque outside lockstat.c. */
+struct lock_class;
+
+/* Set by kernel command-line option "-lockstat". */
+extern bool lockstat_enabled;
+
+struct lock_class *lockstat_class (const char *name);
+struct lock_class *lockstat_sema_class (void);
+void lockstat_acquired (struct lock_class *, bool contended,
+		uint64_t wait_cycles);
+void lockstat_released (struct lock_class *, uint64_t hold_cycles);
+void lockstat_print (int top_n);
+
+#endif /* threads/lockstat.h */
@@ -1,6 +1,7 @@
 #ifndef THREADS_PALLOC_H
 #define THREADS_PALLOC_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 
@@ -14,10 +15,19 @@ enum palloc_flags {
 /* Maximum number of pages to put in user pool. */
 extern size_t user_page_limit;
 
+/* Frees memory that a cache holds but does not need, returning
+   the number of pages freed. */
+typedef size_t palloc_reclaim_func (void);
+
 uint64_t palloc_init (void);
 void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+bool palloc_extend (void *, size_t old_cnt, size_t new_cnt);
+size_t palloc_largest_free (enum palloc_flags);
+void palloc_add_reclaim (palloc_reclaim_func *);
+bool palloc_prezero (void);
+void palloc_print_stats (void);
 
 #endif /* threads/palloc.h */
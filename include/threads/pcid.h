@@ -0,0 +1,14 @@
+#ifndef THREADS_PCID_H
+#define THREADS_PCID_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+void pcid_init (void);
+bool pcid_enabled (void);
+uint64_t pcid_cr3 (uint64_t *pml4);
+void pcid_invalidate (uint64_t *pml4, uint64_t va);
+void pcid_release (uint64_t *pml4);
+void pcid_print_stats (void);
+
+#endif /* threads/pcid.h */
@@ -0,0 +1,20 @@
+#ifndef THREADS_PROFILE_H
+#define THREADS_PROFILE_H
+
+#include <stdbool.h>
+
+struct intr_frame;
+
+/* Maximum number of program counters recorded per sample: the
+   interrupted rip plus up to PROFILE_DEPTH_MAX - 1 callers. */
+#define PROFILE_DEPTH_MAX 7
+
+/* Set by kernel command-line option "-profile[=DEPTH]". */
+extern bool profile_enabled;
+extern int profile_depth;
+
+void profile_init (void);
+void profile_sample (const struct intr_frame *);
+void profile_dump (void);
+
+#endif /* threads/profile.h */
@@ -0,0 +1,24 @@
+#ifndef THREADS_SCHEDSTAT_H
+#define THREADS_SCHEDSTAT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Scheduling events recorded in the trace ring. */
+enum sched_event_type {
+	SCHED_WAKEUP,               /* Thread made ready; ARG = waker's tid. */
+	SCHED_PREEMPT,              /* Running thread made ready; ARG = 0. */
+	SCHED_SWITCH,               /* Switched away from TID; ARG = next tid. */
+	SCHED_EXIT,                 /* Thread exited; ARG = run time in cycles. */
+};
+
+/* Set by kernel command-line option "-schedstat". */
+extern bool schedstat_enabled;
+
+void schedstat_init (void);
+void schedstat_event (enum sched_event_type, int tid, int64_t arg);
+void schedstat_latency (bool wakeup, uint64_t cycles);
+void schedstat_print (void);
+void schedstat_dump (void);
+
+#endif /* threads/schedstat.h */
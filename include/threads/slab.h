@@ -0,0 +1,24 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* A cache of objects of one type.  Opaque outside slab.c. */
+struct kmem_cache;
+
+/* Initializes a newly allocated object. */
+typedef void kmem_ctor_func (void *obj);
+
+void slab_init (void);
+struct kmem_cache *kmem_cache_create (const char *name, size_t size,
+		size_t align, kmem_ctor_func *);
+void *kmem_cache_alloc (struct kmem_cache *);
+void kmem_cache_free (struct kmem_cache *, void *);
+void kmem_cache_print_stats (void);
+
+bool slab_owns (const void *);
+void slab_free (void *);
+size_t slab_object_size (const void *);
+
+#endif /* threads/slab.h */
@@ -3,6 +3,7 @@
 
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /* A counting semaphore. */
 struct semaphore {
@@ -16,13 +17,21 @@ bool sema_try_down (struct semaphore *);
 void sema_up (struct semaphore *);
 void sema_self_test (void);
 
+struct lock_class;
+
 /* Lock. */
 struct lock {
 	struct thread *holder;      /* Thread holding lock (for debugging). */
 	struct semaphore semaphore; /* Binary semaphore controlling access. */
+	struct lock_class *stat;    /* Statistics, if lockstat is on. */
+	uint64_t acquire_tsc;       /* TSC when acquired, if lockstat is on. */
 };
 
-void lock_init (struct lock *);
+/* Locks are named after the expression that initializes them,
+   for lock statistics. */
+#define lock_init(LOCK) lock_init_named ((LOCK), #LOCK)
+
+void lock_init_named (struct lock *, const char *name);
 void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
@@ -38,6 +47,36 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Wait queue.  A list of threads waiting for some event, each
+   tagged with a caller-chosen key.  The caller checks for its
+   event and calls wait_queue_wait() with interrupts off, so that
+   no wakeup can slip in between. */
+struct wait_queue {
+	struct list waiters;        /* List of waiting threads. */
+};
+
+void wait_queue_init (struct wait_queue *);
+void wait_queue_wait (struct wait_queue *, uintptr_t key);
+bool wait_queue_empty (struct wait_queue *);
+struct thread *wait_queue_wake_one (struct wait_queue *);
+int wait_queue_wake_all (struct wait_queue *);
+int wait_queue_wake_key (struct wait_queue *, uintptr_t key, int max);
+
+/* Reader/writer lock. */
+struct rwlock {
+	unsigned readers;           /* Number of readers holding the lock. */
+	struct thread *writer;      /* Writer holding the lock, or NULL. */
+	struct wait_queue read_wq;  /* Readers waiting for the lock. */
+	struct wait_queue write_wq; /* Writers waiting for the lock. */
+};
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_held_for_write (const struct rwlock *);
+
 /* Optimization barrier.
  *
  * The compiler will not reorder operations across an
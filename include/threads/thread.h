@@ -5,6 +5,7 @@
 #include <list.h>
 #include <stdint.h>
 #include "threads/interrupt.h"
+#include "threads/synch.h"
 #ifdef VM
 #include "vm/vm.h"
 #endif
@@ -98,16 +99,57 @@ struct thread {
 	/* project1 alarm clock */
 	int64_t awake_time;
 
+	/* project1 priority donation */
+	int init_priority;                  /* Priority before donations. */
+	struct lock *wait_on_lock;          /* Lock being waited for, if any. */
+	struct list donations;              /* Threads donating to us. */
+	struct list_elem donation_elem;     /* Element in a holder's donations. */
+
+	/* Earliest-deadline-first class.  Times are in timer ticks. */
+	bool edf;                           /* In the EDF class? */
+	bool edf_throttled;                 /* Out of budget for this period? */
+	int64_t edf_runtime;                /* Budget per period. */
+	int64_t edf_period;                 /* Time between releases. */
+	int64_t edf_deadline;               /* Deadline, relative to release. */
+	int64_t edf_budget;                 /* Budget left in this period. */
+	int64_t edf_abs_deadline;           /* Deadline of this period. */
+	int64_t edf_release;                /* Start of the next period. */
+	int64_t edf_job_deadline;           /* Deadline of the current job. */
+	int64_t edf_job_ticks;              /* Ticks run by the current job. */
+	unsigned edf_jobs;                  /* Jobs completed. */
+	unsigned edf_misses;                /* Jobs completed after deadline. */
+
 #ifdef USERPROG
 	/* Owned by userprog/process.c. */
 	uint64_t *pml4;                     /* Page map level 4 */
+
+	/* Owned by userprog/uthread.c. */
+	struct thread *leader;              /* Main thread of our process. */
+	struct uthread *uthread;            /* Join record; NULL in main thread. */
+	struct list uthreads;               /* Main thread: others' records. */
+	struct lock uthread_lock;           /* Main thread: guards uthreads. */
+	uint64_t stack_slots;               /* Main thread: stack slots in use. */
 #endif
 #ifdef VM
 	/* Table for whole virtual memory owned by thread. */
 	struct supplemental_page_table spt;
 #endif
 
+	/* Owned by threads/fpu.c. */
+	void *fpu;                          /* FPU save area, or NULL. */
+
+	/* Owned by thread.c: scheduling statistics, in TSC cycles. */
+	struct list_elem allelem;           /* List element for all threads list. */
+	uint64_t start_tsc;                 /* When created. */
+	uint64_t run_cycles;                /* Time spent running. */
+	uint64_t run_tsc;                   /* When last switched to. */
+	uint64_t ready_tsc;                 /* When last made ready. */
+	bool woken;                         /* Made ready by thread_unblock()? */
+	unsigned voluntary_switches;        /* Blocking or thread_yield(). */
+	unsigned involuntary_switches;      /* Preemption or end of slice. */
+
 	/* Owned by thread.c. */
+	uint64_t ksp;                       /* Saved stack pointer, or 0. */
 	struct intr_frame tf;               /* Information for switching */
 	unsigned magic;                     /* Detects stack overflow. */
 };
@@ -117,6 +159,12 @@ struct thread {
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* If false (default), voluntary switches save only callee-saved
+   registers through switch_threads().
+   If true, every switch saves and restores a full intr_frame
+   through thread_launch(), for comparison. */
+extern bool thread_iret_switch;
+
 void thread_init (void);
 void thread_start (void);
 
@@ -135,10 +183,18 @@ const char *thread_name (void);
 
 void thread_exit (void) NO_RETURN;
 void thread_yield (void);
+void thread_yield_preempted (void);
+
+/* Performs some operation on thread t, given auxiliary data AUX. */
+typedef void thread_action_func (struct thread *t, void *aux);
+void thread_foreach (thread_action_func *, void *);
 
 int thread_get_priority (void);
 void thread_set_priority (int);
 
+bool thread_set_edf (int64_t runtime, int64_t period, int64_t deadline);
+void thread_edf_yield (void);
+
 int thread_get_nice (void);
 void thread_set_nice (int);
 int thread_get_recent_cpu (void);
@@ -151,6 +207,10 @@ void thread_sleep(int64_t ticks);
 void thread_awake(int64_t ticks);
 
 /* project1 priority */
-bool compare_priority(struct list_elem *a, struct list_elem *b);
+bool compare_priority (const struct list_elem *a, const struct list_elem *b,
+		void *aux);
+void thread_donate_priority (struct thread *);
+void thread_refresh_priority (struct thread *);
+void thread_preempt (void);
 
 #endif /* threads/thread.h */
@@ -0,0 +1,34 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <list.h>
+#include <stdbool.h>
+
+/* A function run by a workqueue worker thread. */
+typedef void work_func (void *aux);
+
+/* A unit of deferred work.  The owner embeds it in its own data
+   and initializes it once with work_init(); it can then be
+   scheduled again and again. */
+struct work {
+	struct list_elem elem;      /* Element in workqueue's pending list. */
+	work_func *func;            /* Function to run. */
+	void *aux;                  /* Argument to FUNC. */
+	bool pending;               /* Queued but not yet started? */
+};
+
+struct workqueue;
+
+/* Shared queues, available once workqueue_init() has run. */
+extern struct workqueue *system_wq;          /* PRI_DEFAULT. */
+extern struct workqueue *system_highpri_wq;  /* PRI_MAX. */
+
+void workqueue_init (void);
+struct workqueue *workqueue_create (const char *name, int priority,
+		int worker_cnt);
+void workqueue_flush (struct workqueue *);
+
+void work_init (struct work *, work_func *, void *aux);
+bool schedule_work (struct workqueue *, struct work *);
+
+#endif /* threads/workqueue.h */
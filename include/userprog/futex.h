@@ -0,0 +1,7 @@
+#ifndef USERPROG_FUTEX_H
+#define USERPROG_FUTEX_H
+
+void futex_init (void);
+int futex (int *uaddr, int op, int val);
+
+#endif /* userprog/futex.h */
@@ -0,0 +1,14 @@
+#ifndef USERPROG_UTHREAD_H
+#define USERPROG_UTHREAD_H
+
+#include <debug.h>
+#include <stdint.h>
+#include "threads/thread.h"
+
+tid_t uthread_create (uintptr_t rip, uint64_t arg0, uint64_t arg1);
+int uthread_join (tid_t);
+void uthread_exit (int status) NO_RETURN;
+void uthread_finish (void);
+void uthread_join_all (void);
+
+#endif /* userprog/uthread.h */
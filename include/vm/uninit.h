@@ -5,6 +5,10 @@
 struct page;
 enum vm_type;
 
+/* Loads the contents of a page.  AUX is shared: by all the pages of
+ * a region, and with the copies of those pages that a forked child
+ * makes.  An initializer must only read it and must never free
+ * it; it must stay valid as long as any address space uses it. */
 typedef bool vm_initializer (struct page *, void *aux);
 
 /* Uninitlialized page. The type for implementing the
@@ -1,7 +1,10 @@
 #ifndef VM_VM_H
 #define VM_VM_H
 #include <stdbool.h>
+#include <hash.h>
+#include <tree.h>
 #include "threads/palloc.h"
+#include "threads/synch.h"
 
 enum vm_type {
 	/* page not initialized */
@@ -46,6 +49,8 @@ struct page {
 	struct frame *frame;   /* Back reference for frame */
 
 	/* Your implementation */
+	bool writable;               /* Whether the user may write. */
+	struct hash_elem spt_elem;   /* Element in spt's `pages'. */
 
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
@@ -81,10 +86,30 @@ struct page_operations {
 #define destroy(page) \
 	if ((page)->operations->destroy) (page)->operations->destroy (page)
 
-/* Representation of current process's memory space.
- * We don't want to force you to obey any specific design for this struct.
- * All designs up to you for this. */
+/* A virtual memory area: a range of pages with the same type,
+ * protection and initializer.  Mapping a region records a single
+ * VMA; each page gets its `struct page' when first looked up,
+ * usually at its first fault. */
+struct vma {
+	void *start;                 /* First page. */
+	void *end;                   /* Page after the last one. */
+	enum vm_type type;           /* Type of the pages. */
+	bool writable;               /* Whether the user may write. */
+	vm_initializer *init;        /* Loads each page's contents. */
+	void *aux;                   /* Passed to INIT; shared, read-only. */
+	struct tree_elem elem;       /* Element in spt's `vmas'. */
+};
+
+/* Representation of current process's memory space: the pages
+ * that have a `struct page', hashed by address, and the VMAs that
+ * cover the rest, ordered by address.  A page lies in at most one
+ * VMA, and a page inside a VMA has a `struct page' only once it
+ * has been looked up.  All the threads of a process share its
+ * table, so the spt_*() functions take LOCK. */
 struct supplemental_page_table {
+	struct lock lock;            /* Protects the members below. */
+	struct hash pages;           /* `struct page's, by va. */
+	struct tree vmas;            /* `struct vma's, by start. */
 };
 
 #include "threads/thread.h"
@@ -96,6 +121,15 @@ struct page *spt_find_page (struct supplemental_page_table *spt,
 		void *va);
 bool spt_insert_page (struct supplemental_page_table *spt, struct page *page);
 void spt_remove_page (struct supplemental_page_table *spt, struct page *page);
+struct vma *spt_find_vma (struct supplemental_page_table *spt, void *va);
+bool spt_insert_vma (struct supplemental_page_table *spt, struct vma *vma);
+void spt_remove_vma (struct supplemental_page_table *spt, struct vma *vma);
+
+/* Slab caches for `struct page' and `struct frame'.  Pages from
+ * page_cache may be released with vm_dealloc_page(), since free()
+ * accepts slab objects. */
+extern struct kmem_cache *page_cache;
+extern struct kmem_cache *frame_cache;
 
 void vm_init (void);
 bool vm_try_handle_fault (struct intr_frame *f, void *addr, bool user,
@@ -105,8 +139,11 @@ bool vm_try_handle_fault (struct intr_frame *f, void *addr, bool user,
 	vm_alloc_page_with_initializer ((type), (upage), (writable), NULL, NULL)
 bool vm_alloc_page_with_initializer (enum vm_type type, void *upage,
 		bool writable, vm_initializer *init, void *aux);
+bool vm_alloc_region (enum vm_type type, void *upage, size_t page_cnt,
+		bool writable, vm_initializer *init, void *aux);
 void vm_dealloc_page (struct page *page);
 bool vm_claim_page (void *va);
+bool vm_map_huge_page (void *upage, bool writable);
 enum vm_type page_get_type (struct page *page);
 
 #endif  /* VM_VM_H */
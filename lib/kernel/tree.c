@@ -0,0 +1,335 @@
+/* Ordered tree.
+
+   See tree.h for basic information.  The algorithms follow
+   Cormen, Leiserson, Rivest and Stein, "Introduction to
+   Algorithms", chapter 13, with null pointers in place of the
+   sentinel leaf, which is black. */
+
+#include "tree.h"
+#include "../debug.h"
+
+static void rotate_left (struct tree *, struct tree_elem *);
+static void rotate_right (struct tree *, struct tree_elem *);
+static void insert_fixup (struct tree *, struct tree_elem *);
+static void remove_fixup (struct tree *, struct tree_elem *,
+		struct tree_elem *);
+
+/* Initializes tree T to order elements using LESS, given
+   auxiliary data AUX. */
+void
+tree_init (struct tree *t, tree_less_func *less, void *aux) {
+	ASSERT (t != NULL);
+	ASSERT (less != NULL);
+
+	t->root = NULL;
+	t->elem_cnt = 0;
+	t->less = less;
+	t->aux = aux;
+}
+
+/* Inserts NEW into tree T and returns a null pointer, if no
+   equal element is already in the tree.
+   If an equal element is already in the tree, returns it
+   without inserting NEW. */
+struct tree_elem *
+tree_insert (struct tree *t, struct tree_elem *new) {
+	struct tree_elem *parent = NULL;
+	struct tree_elem **link = &t->root;
+
+	while (*link != NULL) {
+		parent = *link;
+		if (t->less (new, parent, t->aux))
+			link = &parent->left;
+		else if (t->less (parent, new, t->aux))
+			link = &parent->right;
+		else
+			return parent;
+	}
+
+	new->parent = parent;
+	new->left = new->right = NULL;
+	new->red = true;
+	*link = new;
+	t->elem_cnt++;
+	insert_fixup (t, new);
+	return NULL;
+}
+
+/* Finds and returns an element equal to E in tree T, or a null
+   pointer if no equal element exists in the tree. */
+struct tree_elem *
+tree_find (struct tree *t, const struct tree_elem *e) {
+	struct tree_elem *n = t->root;
+
+	while (n != NULL)
+		if (t->less (e, n, t->aux))
+			n = n->left;
+		else if (t->less (n, e, t->aux))
+			n = n->right;
+		else
+			return n;
+	return NULL;
+}
+
+/* Returns the greatest element in tree T that is less than or
+   equal to E, or a null pointer if every element is greater
+   than E.  E need not be in T. */
+struct tree_elem *
+tree_floor (struct tree *t, const struct tree_elem *e) {
+	struct tree_elem *n = t->root;
+	struct tree_elem *floor = NULL;
+
+	while (n != NULL)
+		if (t->less (e, n, t->aux))
+			n = n->left;
+		else {
+			floor = n;
+			n = n->right;
+		}
+	return floor;
+}
+
+/* Replaces OLD, a child of PARENT or the root of T if PARENT is
+   null, by NEW, which may be null. */
+static void
+replace_child (struct tree *t, struct tree_elem *parent,
+		struct tree_elem *old, struct tree_elem *new) {
+	if (parent == NULL)
+		t->root = new;
+	else if (parent->left == old)
+		parent->left = new;
+	else
+		parent->right = new;
+	if (new != NULL)
+		new->parent = parent;
+}
+
+/* Returns true if E is red, false if it is black or null. */
+static inline bool
+is_red (const struct tree_elem *e) {
+	return e != NULL && e->red;
+}
+
+/* Removes E, which must be in tree T, from T. */
+void
+tree_remove (struct tree *t, struct tree_elem *e) {
+	struct tree_elem *child, *parent;
+	bool removed_red;
+
+	ASSERT (t->elem_cnt > 0);
+
+	if (e->left == NULL || e->right == NULL) {
+		/* E has at most one child, which takes its place. */
+		child = e->left != NULL ? e->left : e->right;
+		parent = e->parent;
+		removed_red = e->red;
+		replace_child (t, parent, e, child);
+	} else {
+		/* E's successor, which has no left child, takes its
+		   place, and the successor's right child takes the
+		   successor's. */
+		struct tree_elem *next = e->right;
+
+		while (next->left != NULL)
+			next = next->left;
+		child = next->right;
+		removed_red = next->red;
+		if (next->parent == e)
+			parent = next;
+		else {
+			parent = next->parent;
+			replace_child (t, parent, next, child);
+			next->right = e->right;
+			next->right->parent = next;
+		}
+		replace_child (t, e->parent, e, next);
+		next->left = e->left;
+		next->left->parent = next;
+		next->red = e->red;
+	}
+
+	t->elem_cnt--;
+	if (!removed_red)
+		remove_fixup (t, child, parent);
+}
+
+/* Returns the least element in tree T, or a null pointer if T
+   is empty. */
+struct tree_elem *
+tree_first (struct tree *t) {
+	struct tree_elem *e = t->root;
+
+	if (e != NULL)
+		while (e->left != NULL)
+			e = e->left;
+	return e;
+}
+
+/* Returns the element that follows E in its tree, or a null
+   pointer if E is the greatest.  The results are undefined if
+   the tree has been modified since E was obtained, except by
+   removing elements other than E. */
+struct tree_elem *
+tree_next (struct tree_elem *e) {
+	if (e->right != NULL) {
+		e = e->right;
+		while (e->left != NULL)
+			e = e->left;
+		return e;
+	}
+	while (e->parent != NULL && e == e->parent->right)
+		e = e->parent;
+	return e->parent;
+}
+
+/* Returns the number of elements in T. */
+size_t
+tree_size (struct tree *t) {
+	return t->elem_cnt;
+}
+
+/* Returns true if T contains no elements, false otherwise. */
+bool
+tree_empty (struct tree *t) {
+	return t->elem_cnt == 0;
+}
+
+/* Makes E's right child the parent of E. */
+static void
+rotate_left (struct tree *t, struct tree_elem *e) {
+	struct tree_elem *r = e->right;
+
+	e->right = r->left;
+	if (r->left != NULL)
+		r->left->parent = e;
+	replace_child (t, e->parent, e, r);
+	r->left = e;
+	e->parent = r;
+}
+
+/* Makes E's left child the parent of E. */
+static void
+rotate_right (struct tree *t, struct tree_elem *e) {
+	struct tree_elem *l = e->left;
+
+	e->left = l->right;
+	if (l->right != NULL)
+		l->right->parent = e;
+	replace_child (t, e->parent, e, l);
+	l->right = e;
+	e->parent = l;
+}
+
+/* Restores the red-black properties after inserting E, which is
+   red and may have a red parent. */
+static void
+insert_fixup (struct tree *t, struct tree_elem *e) {
+	struct tree_elem *parent;
+
+	while ((parent = e->parent) != NULL && parent->red) {
+		/* PARENT is red, so it is not the root. */
+		struct tree_elem *grand = parent->parent;
+
+		if (parent == grand->left) {
+			struct tree_elem *uncle = grand->right;
+
+			if (is_red (uncle)) {
+				parent->red = uncle->red = false;
+				grand->red = true;
+				e = grand;
+				continue;
+			}
+			if (e == parent->right) {
+				rotate_left (t, parent);
+				parent = e;
+			}
+			parent->red = false;
+			grand->red = true;
+			rotate_right (t, grand);
+			break;
+		} else {
+			struct tree_elem *uncle = grand->left;
+
+			if (is_red (uncle)) {
+				parent->red = uncle->red = false;
+				grand->red = true;
+				e = grand;
+				continue;
+			}
+			if (e == parent->left) {
+				rotate_right (t, parent);
+				parent = e;
+			}
+			parent->red = false;
+			grand->red = true;
+			rotate_left (t, grand);
+			break;
+		}
+	}
+	t->root->red = false;
+}
+
+/* Restores the red-black properties after removing a black
+   element, whose place was taken by E, a child of PARENT.  E may
+   be null. */
+static void
+remove_fixup (struct tree *t, struct tree_elem *e, struct tree_elem *parent) {
+	while (e != t->root && !is_red (e)) {
+		/* The path through E is one black short, so E's sibling
+		   exists. */
+		if (e == parent->left) {
+			struct tree_elem *sibling = parent->right;
+
+			if (sibling->red) {
+				sibling->red = false;
+				parent->red = true;
+				rotate_left (t, parent);
+				sibling = parent->right;
+			}
+			if (!is_red (sibling->left) && !is_red (sibling->right)) {
+				sibling->red = true;
+				e = parent;
+				parent = e->parent;
+				continue;
+			}
+			if (!is_red (sibling->right)) {
+				sibling->left->red = false;
+				sibling->red = true;
+				rotate_right (t, sibling);
+				sibling = parent->right;
+			}
+			sibling->red = parent->red;
+			parent->red = false;
+			sibling->right->red = false;
+			rotate_left (t, parent);
+		} else {
+			struct tree_elem *sibling = parent->left;
+
+			if (sibling->red) {
+				sibling->red = false;
+				parent->red = true;
+				rotate_right (t, parent);
+				sibling = parent->left;
+			}
+			if (!is_red (sibling->left) && !is_red (sibling->right)) {
+				sibling->red = true;
+				e = parent;
+				parent = e->parent;
+				continue;
+			}
+			if (!is_red (sibling->left)) {
+				sibling->right->red = false;
+				sibling->red = true;
+				rotate_left (t, sibling);
+				sibling = parent->left;
+			}
+			sibling->red = parent->red;
+			parent->red = false;
+			sibling->left->red = false;
+			rotate_right (t, parent);
+		}
+		e = t->root;
+	}
+	if (e != NULL)
+		e->red = false;
+}
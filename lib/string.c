@@ -1,5 +1,140 @@
 #include <string.h>
 #include <debug.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* memcpy(), memmove() and memset() work a word at a time: bytes
+   up to the first word boundary of the destination, then whole
+   words, then the bytes that are left.  On CPUs with Enhanced REP
+   MOVSB/STOSB (ERMS), "rep movsb" and "rep stosb" beat the word
+   loops for all but short blocks, so string_init() selects them
+   for blocks of at least REP_MIN bytes. */
+
+/* The scanning functions, strlen(), strnlen(), strchr(),
+   memchr() and strcmp(), also look at a word at a time.  A word
+   holds a zero byte if has_zero() is nonzero.  A string may end
+   just before an unmapped page, so they read strings only with
+   aligned loads, which never cross a page boundary; they may read
+   a few bytes before the start or after the end of a string, but
+   only within the same page.  memcmp() knows its blocks' sizes
+   and compares with unaligned loads. */
+
+/* A word that may be unaligned and may alias anything. */
+typedef uint64_t word_t __attribute__ ((__may_alias__, __aligned__ (1)));
+#define WORD_SIZE sizeof (word_t)
+
+/* Smallest page size, for strcmp()'s page crossing checks. */
+#define PAGE_SIZE 4096
+
+/* Each byte of a word set to 0x01, and to 0x80. */
+#define ONES 0x0101010101010101ULL
+#define HIGHS 0x8080808080808080ULL
+
+/* Returns nonzero if W contains a zero byte.  The lowest bit set
+   in the result is the top bit of W's first zero byte. */
+static inline uint64_t
+has_zero (uint64_t w) {
+	return (w - ONES) & ~w & HIGHS;
+}
+
+/* Returns the index of the byte whose top bit is the lowest bit
+   set in MASK, a nonzero result of has_zero(). */
+static inline size_t
+zero_index (uint64_t mask) {
+	return __builtin_ctzll (mask) / 8;
+}
+
+/* Returns the aligned word that contains P. */
+static inline const word_t *
+word_of (const void *p) {
+	return (const word_t *) ((uintptr_t) p & ~(WORD_SIZE - 1));
+}
+
+/* Returns a word with each byte before P's offset in its word
+   set to 0xff, so that ORing it in hides those bytes from
+   has_zero(). */
+static inline uint64_t
+before_mask (const void *p) {
+	return (1ULL << (8 * ((uintptr_t) p % WORD_SIZE))) - 1;
+}
+
+/* Returns SIZE, reduced if need be so that P + SIZE does not
+   wrap around the top of the address space.  Callers such as
+   printf() pass SIZE_MAX to mean "no limit". */
+static inline size_t
+clamp_size (const void *p, size_t size) {
+	size_t room = (uintptr_t) -1 - (uintptr_t) p;
+	return size < room ? size : room;
+}
+
+/* Smallest block for "rep movsb" and "rep stosb". */
+#define REP_MIN 128
+
+/* How to copy and fill large blocks.  The enumerators are nonzero
+   so that block_method lives in .data, not .bss: the kernel clears
+   .bss with memset() before string_init() runs. */
+enum block_method {
+	BLOCK_WORDS = 1,            /* Word loops. */
+	BLOCK_REP = 2               /* "rep movsb" and "rep stosb". */
+};
+static enum block_method block_method = BLOCK_WORDS;
+
+/* Selects the fastest memcpy() and memset() for this CPU. */
+void
+string_init (void) {
+	uint32_t eax, ebx, ecx, edx;
+
+	__asm__ volatile ("cpuid"
+			: "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) : "a" (0), "c" (0));
+	if (eax < 7)
+		return;
+	__asm__ volatile ("cpuid"
+			: "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) : "a" (7), "c" (0));
+	if (ebx & (1 << 9))                 /* ERMS. */
+		block_method = BLOCK_REP;
+}
+
+/* Returns true if P is aligned to a word. */
+static inline bool
+word_aligned (const void *p) {
+	return (uintptr_t) p % WORD_SIZE == 0;
+}
+
+/* Copies SIZE bytes from SRC to DST, from first to last. */
+static void
+copy_forward (unsigned char *dst, const unsigned char *src, size_t size) {
+	if (block_method == BLOCK_REP && size >= REP_MIN) {
+		__asm__ volatile ("rep movsb"
+				: "+D" (dst), "+S" (src), "+c" (size) : : "memory");
+		return;
+	}
+
+	for (; size > 0 && !word_aligned (dst); size--)
+		*dst++ = *src++;
+	for (; size >= WORD_SIZE; size -= WORD_SIZE) {
+		*(word_t *) dst = *(const word_t *) src;
+		dst += WORD_SIZE;
+		src += WORD_SIZE;
+	}
+	while (size-- > 0)
+		*dst++ = *src++;
+}
+
+/* Copies SIZE bytes from SRC to DST, from last to first. */
+static void
+copy_backward (unsigned char *dst, const unsigned char *src, size_t size) {
+	dst += size;
+	src += size;
+	for (; size > 0 && !word_aligned (dst); size--)
+		*--dst = *--src;
+	for (; size >= WORD_SIZE; size -= WORD_SIZE) {
+		dst -= WORD_SIZE;
+		src -= WORD_SIZE;
+		*(word_t *) dst = *(const word_t *) src;
+	}
+	while (size-- > 0)
+		*--dst = *--src;
+}
 
 /* Copies SIZE bytes from SRC to DST, which must not overlap.
    Returns DST. */
@@ -11,8 +146,7 @@ memcpy (void *dst_, const void *src_, size_t size) {
 	ASSERT (dst != NULL || size == 0);
 	ASSERT (src != NULL || size == 0);
 
-	while (size-- > 0)
-		*dst++ = *src++;
+	copy_forward (dst, src, size);
 
 	return dst_;
 }
@@ -27,17 +161,13 @@ memmove (void *dst_, const void *src_, size_t size) {
 	ASSERT (dst != NULL || size == 0);
 	ASSERT (src != NULL || size == 0);
 
-	if (dst < src) {
-		while (size-- > 0)
-			*dst++ = *src++;
-	} else {
-		dst += size;
-		src += size;
-		while (size-- > 0)
-			*--dst = *--src;
-	}
+	/* Copying forward is safe unless DST starts inside SRC. */
+	if (dst <= src || dst >= src + size)
+		copy_forward (dst, src, size);
+	else
+		copy_backward (dst, src, size);
 
-	return dst;
+	return dst_;
 }
 
 /* Find the first differing byte in the two blocks of SIZE bytes
@@ -52,6 +182,10 @@ memcmp (const void *a_, const void *b_, size_t size) {
 	ASSERT (a != NULL || size == 0);
 	ASSERT (b != NULL || size == 0);
 
+	/* Skip equal words, then find the differing byte. */
+	for (; size >= WORD_SIZE; size -= WORD_SIZE, a += WORD_SIZE, b += WORD_SIZE)
+		if (*(const word_t *) a != *(const word_t *) b)
+			break;
 	for (; size-- > 0; a++, b++)
 		if (*a != *b)
 			return *a > *b ? +1 : -1;
@@ -71,6 +205,34 @@ strcmp (const char *a_, const char *b_) {
 	ASSERT (a != NULL);
 	ASSERT (b != NULL);
 
+	/* Step to a word boundary in A. */
+	for (; !word_aligned (a); a++, b++)
+		if (*a == '\0' || *a != *b)
+			return *a < *b ? -1 : *a > *b;
+
+	/* Compare words while they are equal and hold no null.  B's
+	   loads are unaligned, so take them only when they stay in
+	   one page; otherwise fall back to bytes for one word. */
+	for (;;) {
+		uint64_t wa = *(const word_t *) a;
+
+		if (has_zero (wa))
+			break;
+		if ((uintptr_t) b % PAGE_SIZE <= PAGE_SIZE - WORD_SIZE) {
+			if (wa != *(const word_t *) b)
+				break;
+		} else {
+			size_t i;
+
+			for (i = 0; i < WORD_SIZE && a[i] == b[i]; i++)
+				continue;
+			if (i < WORD_SIZE)
+				break;
+		}
+		a += WORD_SIZE;
+		b += WORD_SIZE;
+	}
+
 	while (*a != '\0' && *a == *b) {
 		a++;
 		b++;
@@ -85,15 +247,29 @@ strcmp (const char *a_, const char *b_) {
 void *
 memchr (const void *block_, int ch_, size_t size) {
 	const unsigned char *block = block_;
-	unsigned char ch = ch_;
+	const unsigned char *end;
+	uint64_t pattern = (unsigned char) ch_ * ONES;
+	const word_t *w;
+	uint64_t mask;
 
 	ASSERT (block != NULL || size == 0);
 
-	for (; size-- > 0; block++)
-		if (*block == ch)
-			return (void *) block;
+	if (size == 0)
+		return NULL;
+	end = block + clamp_size (block, size);
 
-	return NULL;
+	/* Look for a zero byte in each word XORed with CH in every
+	   byte. */
+	w = word_of (block);
+	mask = has_zero ((*w ^ pattern) | before_mask (block));
+	while (mask == 0) {
+		if ((const unsigned char *) ++w >= end)
+			return NULL;
+		mask = has_zero (*w ^ pattern);
+	}
+
+	block = (const unsigned char *) w + zero_index (mask);
+	return block < end ? (void *) block : NULL;
 }
 
 /* Finds and returns the first occurrence of C in STRING, or a
@@ -103,16 +279,23 @@ memchr (const void *block_, int ch_, size_t size) {
 char *
 strchr (const char *string, int c_) {
 	char c = c_;
+	uint64_t pattern = (unsigned char) c * ONES;
+	const word_t *w;
+	uint64_t mask;
 
 	ASSERT (string);
 
-	for (;;)
-		if (*string == c)
-			return (char *) string;
-		else if (*string == '\0')
-			return NULL;
-		else
-			string++;
+	/* Find the first word with a null or a C, then the byte. */
+	w = word_of (string);
+	mask = has_zero ((*w ^ pattern) | before_mask (string))
+		| has_zero (*w | before_mask (string));
+	while (mask == 0) {
+		w++;
+		mask = has_zero (*w ^ pattern) | has_zero (*w);
+	}
+
+	string = (const char *) w + zero_index (mask);
+	return *string == c ? (char *) string : NULL;
 }
 
 /* Returns the length of the initial substring of STRING that
@@ -257,9 +440,23 @@ strtok_r (char *s, const char *delimiters, char **save_ptr) {
 void *
 memset (void *dst_, int value, size_t size) {
 	unsigned char *dst = dst_;
+	word_t word;
 
 	ASSERT (dst != NULL || size == 0);
 
+	if (block_method == BLOCK_REP && size >= REP_MIN) {
+		__asm__ volatile ("rep stosb"
+				: "+D" (dst), "+c" (size) : "a" (value) : "memory");
+		return dst_;
+	}
+
+	word = (unsigned char) value * 0x0101010101010101ULL;
+	for (; size > 0 && !word_aligned (dst); size--)
+		*dst++ = value;
+	for (; size >= WORD_SIZE; size -= WORD_SIZE) {
+		*(word_t *) dst = word;
+		dst += WORD_SIZE;
+	}
 	while (size-- > 0)
 		*dst++ = value;
 
@@ -269,24 +466,40 @@ memset (void *dst_, int value, size_t size) {
 /* Returns the length of STRING. */
 size_t
 strlen (const char *string) {
-	const char *p;
+	const word_t *w;
+	uint64_t mask;
 
 	ASSERT (string);
 
-	for (p = string; *p != '\0'; p++)
-		continue;
-	return p - string;
+	w = word_of (string);
+	mask = has_zero (*w | before_mask (string));
+	while (mask == 0)
+		mask = has_zero (*++w);
+	return (const char *) w + zero_index (mask) - string;
 }
 
 /* If STRING is less than MAXLEN characters in length, returns
    its actual length.  Otherwise, returns MAXLEN. */
 size_t
 strnlen (const char *string, size_t maxlen) {
+	const char *end;
+	const word_t *w;
+	uint64_t mask;
 	size_t length;
 
-	for (length = 0; string[length] != '\0' && length < maxlen; length++)
-		continue;
-	return length;
+	if (maxlen == 0)
+		return 0;
+	end = string + clamp_size (string, maxlen);
+
+	w = word_of (string);
+	mask = has_zero (*w | before_mask (string));
+	while (mask == 0) {
+		if ((const char *) ++w >= end)
+			return maxlen;
+		mask = has_zero (*w);
+	}
+	length = (const char *) w + zero_index (mask) - string;
+	return length < maxlen ? length : maxlen;
 }
 
 /* Copies string SRC to DST.  If SRC is longer than SIZE - 1
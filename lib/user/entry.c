@@ -1,3 +1,4 @@
+#include <string.h>
 #include <syscall.h>
 
 int main (int, char *[]);
@@ -5,5 +6,6 @@ void _start (int argc, char *argv[]);
 
 void
 _start (int argc, char *argv[]) {
+	string_init ();
 	exit (main (argc, argv));
 }
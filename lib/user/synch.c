@@ -0,0 +1,118 @@
+#include <synch.h>
+#include <limits.h>
+#include <syscall.h>
+#include <syscall-nr.h>
+
+/* Mutexes and condition variables on top of futex().
+
+   Locking and unlocking an uncontended mutex is a single atomic
+   instruction each, and signaling a condition variable nobody
+   waits on touches only user memory.  The kernel is entered only
+   to sleep, or to wake a thread that is known to be asleep.
+
+   The mutex follows Drepper, "Futexes Are Tricky", mutex 2. */
+
+/* Atomically replaces *P by NEW if it equals OLD.  Returns the
+   previous value of *P. */
+static int
+cmpxchg (int *p, int old, int new) {
+	__atomic_compare_exchange_n (p, &old, new, false,
+			__ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+	return old;
+}
+
+/* Atomically stores NEW in *P and returns the previous value. */
+static int
+xchg (int *p, int new) {
+	return __atomic_exchange_n (p, new, __ATOMIC_ACQUIRE);
+}
+
+/* Initializes M as unlocked. */
+void
+mutex_init (struct mutex *m) {
+	m->state = 0;
+}
+
+/* Acquires M, sleeping in the kernel while another thread holds
+   it.  Mutexes are not recursive. */
+void
+mutex_lock (struct mutex *m) {
+	int c = cmpxchg (&m->state, 0, 1);
+
+	if (c == 0)
+		return;
+
+	/* Contended: mark the mutex as having waiters, and sleep
+	   until we are the one that changes it from unlocked. */
+	if (c != 2)
+		c = xchg (&m->state, 2);
+	while (c != 0) {
+		futex (&m->state, FUTEX_WAIT, 2);
+		c = xchg (&m->state, 2);
+	}
+}
+
+/* Acquires M if no thread holds it.  Returns true on success. */
+bool
+mutex_trylock (struct mutex *m) {
+	return cmpxchg (&m->state, 0, 1) == 0;
+}
+
+/* Releases M, which the calling thread must hold, waking one
+   waiter if there may be any. */
+void
+mutex_unlock (struct mutex *m) {
+	if (__atomic_fetch_sub (&m->state, 1, __ATOMIC_RELEASE) != 1) {
+		__atomic_store_n (&m->state, 0, __ATOMIC_RELEASE);
+		futex (&m->state, FUTEX_WAKE, 1);
+	}
+}
+
+/* Initializes CV with no waiters. */
+void
+condvar_init (struct condvar *cv) {
+	cv->seq = 0;
+	cv->waiters = 0;
+}
+
+/* Atomically releases M and waits for CV to be signaled, then
+   reacquires M.  M must be held.  Like the kernel's condition
+   variables these are Mesa style, so the caller must recheck its
+   condition after returning. */
+void
+condvar_wait (struct condvar *cv, struct mutex *m) {
+	int seq, c;
+
+	cv->waiters++;
+	seq = __atomic_load_n (&cv->seq, __ATOMIC_RELAXED);
+	mutex_unlock (m);
+
+	/* Returns at once if a signal already bumped SEQ. */
+	futex (&cv->seq, FUTEX_WAIT, seq);
+
+	/* Other threads may have been woken with us, so take M in
+	   the contended state to make sure they get woken in turn. */
+	while ((c = xchg (&m->state, 2)) != 0)
+		futex (&m->state, FUTEX_WAIT, 2);
+	cv->waiters--;
+}
+
+/* Wakes one thread waiting on CV, if any.  M, the mutex used
+   with CV, must be held. */
+void
+condvar_signal (struct condvar *cv, struct mutex *m UNUSED) {
+	if (cv->waiters == 0)
+		return;
+	__atomic_fetch_add (&cv->seq, 1, __ATOMIC_RELEASE);
+	futex (&cv->seq, FUTEX_WAKE, 1);
+}
+
+/* Wakes every thread waiting on CV.  M, the mutex used with CV,
+   must be held. */
+void
+condvar_broadcast (struct condvar *cv, struct mutex *m UNUSED) {
+	if (cv->waiters == 0)
+		return;
+	__atomic_fetch_add (&cv->seq, 1, __ATOMIC_RELEASE);
+	futex (&cv->seq, FUTEX_WAKE, INT_MAX);
+}
@@ -194,3 +194,31 @@ int
 umount (const char *path) {
 	return syscall1 (SYS_UMOUNT, path);
 }
+
+int
+futex (int *addr, int op, int val) {
+	return syscall3 (SYS_FUTEX, addr, op, val);
+}
+
+/* First code run by a thread started by uthread_create(). */
+static void
+uthread_start (void (*function) (void *), void *aux) {
+	function (aux);
+	uthread_exit (0);
+}
+
+tid_t
+uthread_create (void (*function) (void *), void *aux) {
+	return (tid_t) syscall3 (SYS_THREAD_CREATE, uthread_start, function, aux);
+}
+
+int
+uthread_join (tid_t tid) {
+	return syscall1 (SYS_THREAD_JOIN, tid);
+}
+
+void
+uthread_exit (int status) {
+	syscall1 (SYS_THREAD_EXIT, status);
+	NOT_REACHED ();
+}
@@ -0,0 +1,177 @@
+/* Test program for lib/kernel/tree.c.
+
+   Inserts and removes values in random order, checking the
+   red-black properties, the traversal order, and tree_floor()
+   after every operation.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <random.h>
+#include <stdio.h>
+#include <tree.h>
+#include "threads/test.h"
+
+/* Maximum number of elements in a tree that we will test. */
+#define MAX_SIZE 64
+
+/* A tree element. */
+struct value
+  {
+    struct tree_elem elem;      /* Tree element. */
+    int value;                  /* Item value. */
+  };
+
+static void shuffle (int[], size_t);
+static bool value_less (const struct tree_elem *, const struct tree_elem *,
+                        void *);
+static int verify_colors (struct tree_elem *, struct tree_elem *parent);
+static void verify_tree (struct tree *, const bool in[], int size);
+
+/* Test the tree implementation. */
+void
+test (void)
+{
+  int size;
+
+  printf ("testing various size trees:");
+  for (size = 0; size < MAX_SIZE; size++)
+    {
+      int repeat;
+
+      printf (" %d", size);
+      for (repeat = 0; repeat < 10; repeat++)
+        {
+          static struct value values[MAX_SIZE];
+          bool in[MAX_SIZE];
+          int order[MAX_SIZE];
+          struct tree tree;
+          int i;
+
+          /* Put values 0, 2, 4, ... in VALUES, leaving odd values
+             for tree_floor() to miss, and 0...SIZE in random
+             order in ORDER. */
+          for (i = 0; i < size; i++)
+            {
+              values[i].value = i * 2;
+              in[i] = false;
+              order[i] = i;
+            }
+          shuffle (order, size);
+
+          /* Insert them, then try inserting each again. */
+          tree_init (&tree, value_less, NULL);
+          for (i = 0; i < size; i++)
+            {
+              ASSERT (tree_insert (&tree, &values[order[i]].elem) == NULL);
+              in[order[i]] = true;
+              verify_tree (&tree, in, size);
+            }
+          for (i = 0; i < size; i++)
+            {
+              struct value dup = { .value = values[i].value };
+              ASSERT (tree_insert (&tree, &dup.elem) == &values[i].elem);
+              ASSERT (tree_find (&tree, &dup.elem) == &values[i].elem);
+            }
+
+          /* Remove them in another order. */
+          shuffle (order, size);
+          for (i = 0; i < size; i++)
+            {
+              tree_remove (&tree, &values[order[i]].elem);
+              in[order[i]] = false;
+              verify_tree (&tree, in, size);
+            }
+          ASSERT (tree_empty (&tree));
+        }
+    }
+
+  printf (" done\n");
+  printf ("tree: PASS\n");
+}
+
+/* Shuffles the CNT elements in ARRAY into random order. */
+static void
+shuffle (int *array, size_t cnt)
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      size_t j = i + random_ulong () % (cnt - i);
+      int t = array[j];
+      array[j] = array[i];
+      array[i] = t;
+    }
+}
+
+/* Returns true if value A is less than value B, false
+   otherwise. */
+static bool
+value_less (const struct tree_elem *a_, const struct tree_elem *b_,
+            void *aux UNUSED)
+{
+  const struct value *a = tree_entry (a_, struct value, elem);
+  const struct value *b = tree_entry (b_, struct value, elem);
+
+  return a->value < b->value;
+}
+
+/* Verifies that no red element in the subtree at E has a red
+   child and that E's parent is PARENT, and returns the number
+   of black elements on every path down from E. */
+static int
+verify_colors (struct tree_elem *e, struct tree_elem *parent)
+{
+  int left, right;
+
+  if (e == NULL)
+    return 0;
+  ASSERT (e->parent == parent);
+  ASSERT (!e->red || ((e->left == NULL || !e->left->red)
+                      && (e->right == NULL || !e->right->red)));
+  left = verify_colors (e->left, e);
+  right = verify_colors (e->right, e);
+  ASSERT (left == right);
+  return left + !e->red;
+}
+
+/* Verifies that TREE is a valid red-black tree holding exactly
+   the values 2 * I for which IN[I] is true, I < SIZE, and
+   that tree_floor() finds the right value for each odd value. */
+static void
+verify_tree (struct tree *tree, const bool in[], int size)
+{
+  struct tree_elem *e;
+  size_t cnt = 0;
+  int i, floor;
+
+  ASSERT (tree->root == NULL || !tree->root->red);
+  verify_colors (tree->root, NULL);
+
+  e = tree_first (tree);
+  for (i = 0; i < size; i++)
+    if (in[i])
+      {
+        ASSERT (e != NULL);
+        ASSERT (tree_entry (e, struct value, elem)->value == i * 2);
+        e = tree_next (e);
+        cnt++;
+      }
+  ASSERT (e == NULL);
+  ASSERT (cnt == tree_size (tree));
+
+  for (i = 0, floor = -1; i < size; i++)
+    {
+      struct value probe = { .value = i * 2 + 1 };
+
+      if (in[i])
+        floor = i * 2;
+      e = tree_floor (tree, &probe.elem);
+      ASSERT (floor < 0 ? e == NULL
+              : tree_entry (e, struct value, elem)->value == floor);
+    }
+}
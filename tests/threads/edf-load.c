@@ -0,0 +1,97 @@
+/* Runs two periodic EDF tasks next to a CPU hog at PRI_MAX and
+   checks that the EDF class sits above the priority scheduler:
+   with 40% of the CPU reserved and each job well within its
+   budget, no deadline may be missed.  Also checks that admission
+   control refuses a task that would overcommit the CPU. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define JOB_CNT 10
+
+struct task 
+  {
+    const char *name;
+    int64_t runtime, period, deadline;  /* EDF parameters. */
+    int64_t work;                       /* Ticks of work per job. */
+    volatile unsigned jobs, misses;     /* Results. */
+  };
+
+static struct task tasks[2] = {
+  {"edf a", 3, 10, 10, 2, 0, 0},
+  {"edf b", 4, 20, 15, 3, 0, 0},
+};
+
+static thread_func edf_task, hog;
+static struct semaphore done;
+static volatile int64_t hog_spins;
+
+void
+test_edf_load (void) 
+{
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&done, 0);
+
+  ASSERT (thread_set_edf (3, 10, 10));
+  ASSERT (thread_set_edf (0, 0, 0));
+  if (!thread_set_edf (0, 0, 0) || thread_set_edf (2, 10, 1))
+    fail ("invalid EDF parameters accepted");
+
+  for (i = 0; i < 2; i++)
+    thread_create (tasks[i].name, PRI_MAX, edf_task, &tasks[i]);
+  /* Densities of 30% + 27% (4 ticks within a 15-tick deadline)
+     + 50% are more than the admission limit. */
+  if (thread_set_edf (5, 10, 10))
+    fail ("admitted a task that overcommits the CPU");
+  msg ("admission control refused 50%% on top of 57%%.");
+  /* Only 10% of the CPU, but 50% dense with its 4-tick deadline. */
+  if (thread_set_edf (2, 20, 4))
+    fail ("admitted a task by utilization instead of density");
+  msg ("admission control refused a short-deadline task.");
+
+  /* The hog keeps everything but the EDF tasks off the CPU
+     until both are done. */
+  thread_create ("hog", PRI_MAX, hog, NULL);
+  for (i = 0; i < 2; i++)
+    sema_down (&done);
+
+  for (i = 0; i < 2; i++)
+    msg ("%s: %u jobs, %u deadlines missed.",
+         tasks[i].name, tasks[i].jobs, tasks[i].misses);
+  if (hog_spins == 0)
+    fail ("hog never ran");
+}
+
+static void
+edf_task (void *task_) 
+{
+  struct task *task = task_;
+  int i;
+
+  if (!thread_set_edf (task->runtime, task->period, task->deadline))
+    fail ("%s: not admitted", task->name);
+
+  for (i = 0; i < JOB_CNT; i++) 
+    {
+      while (thread_current ()->edf_job_ticks < task->work)
+        continue;
+      thread_edf_yield ();
+    }
+  task->misses = thread_current ()->edf_misses;
+  task->jobs = thread_current ()->edf_jobs;
+  sema_up (&done);
+}
+
+static void
+hog (void *aux UNUSED) 
+{
+  while (tasks[0].jobs == 0 || tasks[1].jobs == 0)
+    hog_spins++;
+}
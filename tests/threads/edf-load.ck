@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(edf-load) begin
+(edf-load) admission control refused 50% on top of 57%.
+(edf-load) admission control refused a short-deadline task.
+(edf-load) edf a: 10 jobs, 0 deadlines missed.
+(edf-load) edf b: 10 jobs, 0 deadlines missed.
+(edf-load) end
+EOF
+pass;
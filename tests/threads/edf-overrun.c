@@ -0,0 +1,82 @@
+/* Runs an EDF task whose jobs need more than its budget next to
+   a well-behaved EDF task and a CPU hog at PRI_MAX.  Budget
+   enforcement throttles the overrunning task at the end of its
+   budget in every period, so each of its jobs finishes in the
+   following period and misses its deadline, while the other
+   task is unaffected and the hog still gets the rest of the
+   CPU. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define JOB_CNT 8
+
+struct task 
+  {
+    const char *name;
+    int64_t runtime, period, deadline;  /* EDF parameters. */
+    int64_t work;                       /* Ticks of work per job. */
+    volatile unsigned jobs, misses;     /* Results. */
+  };
+
+static struct task tasks[2] = {
+  {"overrun", 2, 10, 10, 3, 0, 0},
+  {"steady", 2, 10, 10, 1, 0, 0},
+};
+
+static thread_func edf_task, hog;
+static struct semaphore done;
+static volatile int64_t hog_spins;
+
+void
+test_edf_overrun (void) 
+{
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&done, 0);
+  for (i = 0; i < 2; i++)
+    thread_create (tasks[i].name, PRI_MAX, edf_task, &tasks[i]);
+  thread_create ("hog", PRI_MAX, hog, NULL);
+  for (i = 0; i < 2; i++)
+    sema_down (&done);
+
+  for (i = 0; i < 2; i++)
+    msg ("%s: %u jobs, %u deadlines missed.",
+         tasks[i].name, tasks[i].jobs, tasks[i].misses);
+  if (hog_spins == 0)
+    fail ("hog never ran");
+  msg ("hog ran.");
+}
+
+static void
+edf_task (void *task_) 
+{
+  struct task *task = task_;
+  int i;
+
+  if (!thread_set_edf (task->runtime, task->period, task->deadline))
+    fail ("%s: not admitted", task->name);
+
+  for (i = 0; i < JOB_CNT; i++) 
+    {
+      while (thread_current ()->edf_job_ticks < task->work)
+        continue;
+      thread_edf_yield ();
+    }
+  task->misses = thread_current ()->edf_misses;
+  task->jobs = thread_current ()->edf_jobs;
+  sema_up (&done);
+}
+
+static void
+hog (void *aux UNUSED) 
+{
+  while (tasks[0].jobs == 0 || tasks[1].jobs == 0)
+    hog_spins++;
+}
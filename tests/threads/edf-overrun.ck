@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(edf-overrun) begin
+(edf-overrun) overrun: 8 jobs, 8 deadlines missed.
+(edf-overrun) steady: 8 jobs, 0 deadlines missed.
+(edf-overrun) hog ran.
+(edf-overrun) end
+EOF
+pass;
@@ -0,0 +1,73 @@
+/* Checks that realloc() resizes blocks in place when it can:
+   a small block that already has room for the new size, and a
+   big block whose following pages are free.  Also checks that
+   the contents survive every resize. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/malloc.h"
+#include "threads/vaddr.h"
+
+static void
+fill (char *p, size_t size) 
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    p[i] = i % 251;
+}
+
+static void
+check (const char *p, size_t size, const char *what) 
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    if (p[i] != (char) (i % 251))
+      fail ("%s: byte %zu corrupted", what, i);
+}
+
+void
+test_malloc_realloc (void) 
+{
+  char *p, *q;
+
+  /* 600 bytes take a 768-byte block, so growing to 700 bytes
+     must not move the block. */
+  p = malloc (600);
+  ASSERT (p != NULL);
+  fill (p, 600);
+  q = realloc (p, 700);
+  if (q != p)
+    fail ("small block moved");
+  check (q, 600, "small block");
+  msg ("small block grown in place.");
+
+  /* Growing past the size class moves it. */
+  fill (q, 700);
+  p = realloc (q, 2000);
+  ASSERT (p != NULL);
+  check (p, 700, "moved block");
+  msg ("small block moved to a larger class.");
+  free (p);
+
+  /* A 3-page big block comes from a 4-page buddy block whose
+     last page is given back, so it can grow by that page. */
+  p = malloc (3 * PGSIZE - 64);
+  ASSERT (p != NULL);
+  fill (p, 3 * PGSIZE - 64);
+  q = realloc (p, 4 * PGSIZE - 64);
+  if (q != p)
+    fail ("big block moved");
+  check (q, 3 * PGSIZE - 64, "big block");
+  msg ("big block grown in place.");
+
+  /* Shrinking a big block never moves it. */
+  p = realloc (q, PGSIZE);
+  if (p != q)
+    fail ("big block moved when shrunk");
+  check (p, PGSIZE, "shrunk block");
+  msg ("big block shrunk in place.");
+  free (p);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(malloc-realloc) begin
+(malloc-realloc) small block grown in place.
+(malloc-realloc) small block moved to a larger class.
+(malloc-realloc) big block grown in place.
+(malloc-realloc) big block shrunk in place.
+(malloc-realloc) end
+EOF
+pass;
@@ -0,0 +1,50 @@
+/* Maps a 2 MiB user page into a fresh page map, checks that
+   addresses across it translate correctly, then unmaps one 4 kB
+   page in the middle and checks that only that page went away,
+   which requires splitting the large page. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+#define UPAGE ((uint8_t *) 0x40000000)  /* 2 MiB aligned user address. */
+
+void
+test_mmu_large_page (void) 
+{
+  uint64_t *pml4;
+  uint8_t *kpage;
+  size_t ofs;
+
+  pml4 = pml4_create ();
+  ASSERT (pml4 != NULL);
+  kpage = palloc_get_multiple (PAL_USER | PAL_ZERO,
+                               LARGE_PAGE_SIZE / PGSIZE);
+  if (kpage == NULL)
+    fail ("no 2 MiB of contiguous user memory");
+
+  if (!pml4_set_large_page (pml4, UPAGE, kpage, true))
+    fail ("pml4_set_large_page failed");
+  for (ofs = 0; ofs < LARGE_PAGE_SIZE; ofs += 0x12345)
+    if (pml4_get_page (pml4, UPAGE + ofs) != kpage + ofs)
+      fail ("wrong translation at offset %#zx", ofs);
+  msg ("large page mapped.");
+
+  if (pml4_set_large_page (pml4, UPAGE, kpage, true))
+    fail ("large page mapped twice");
+
+  pml4_clear_page (pml4, UPAGE + 7 * PGSIZE);
+  if (pml4_get_page (pml4, UPAGE + 7 * PGSIZE) != NULL)
+    fail ("cleared page still mapped");
+  if (pml4_get_page (pml4, UPAGE + 6 * PGSIZE) != kpage + 6 * PGSIZE
+      || (pml4_get_page (pml4, UPAGE + 8 * PGSIZE + 5)
+          != kpage + 8 * PGSIZE + 5))
+    fail ("neighbors of cleared page lost");
+  msg ("large page split to unmap one page.");
+
+  /* pml4_destroy() frees the pages still mapped. */
+  palloc_free_page (kpage + 7 * PGSIZE);
+  pml4_destroy (pml4);
+}
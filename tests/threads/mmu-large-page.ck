@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(mmu-large-page) begin
+(mmu-large-page) large page mapped.
+(mmu-large-page) large page split to unmap one page.
+(mmu-large-page) end
+EOF
+pass;
@@ -0,0 +1,88 @@
+/* Fragmentation benchmark for the page allocator.  Fills much of
+   the kernel pool with blocks of random sizes, frees every other
+   one to punch holes into it, and then times a mix of random
+   allocations and frees in the fragmented pool.  Reports the
+   largest block that can still be obtained at each stage, and
+   checks that freeing everything restores the pool to the state
+   it started in. */
+
+#include <stdio.h>
+#include <random.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "intrinsic.h"
+
+#define BLOCK_CNT 512           /* Blocks allocated at most. */
+#define MAX_PAGES 8             /* Largest block, in pages. */
+#define CHURN_CNT 1024          /* Timed allocations and frees. */
+
+struct block 
+  {
+    void *pages;
+    size_t page_cnt;
+  };
+
+static struct block blocks[BLOCK_CNT];
+
+static size_t
+random_size (void) 
+{
+  return random_ulong () % MAX_PAGES + 1;
+}
+
+void
+test_palloc_frag (void) 
+{
+  size_t initial, largest;
+  uint64_t start, cycles = 0;
+  int cnt, i;
+
+  random_init (0);
+  initial = palloc_largest_free (0);
+  msg ("largest free block at start: %zu pages.", initial);
+
+  /* Fill. */
+  for (cnt = 0; cnt < BLOCK_CNT; cnt++) 
+    {
+      blocks[cnt].page_cnt = random_size ();
+      blocks[cnt].pages = palloc_get_multiple (0, blocks[cnt].page_cnt);
+      if (blocks[cnt].pages == NULL)
+        break;
+    }
+
+  /* Punch holes. */
+  for (i = 0; i < cnt; i += 2) 
+    {
+      palloc_free_multiple (blocks[i].pages, blocks[i].page_cnt);
+      blocks[i].pages = NULL;
+    }
+
+  /* Churn: replace random blocks with blocks of random size. */
+  for (i = 0; i < CHURN_CNT && cnt > 0; i++) 
+    {
+      struct block *b = &blocks[random_ulong () % cnt];
+
+      start = rdtsc ();
+      if (b->pages != NULL)
+        palloc_free_multiple (b->pages, b->page_cnt);
+      b->page_cnt = random_size ();
+      b->pages = palloc_get_multiple (0, b->page_cnt);
+      cycles += rdtsc () - start;
+    }
+  largest = palloc_largest_free (0);
+  msg ("%d blocks, %llu cycles per free and allocation.",
+       cnt, cycles / CHURN_CNT);
+  msg ("largest free block after churn: %zu pages.", largest);
+  palloc_print_stats ();
+
+  /* Free everything.  The buddies must all merge again. */
+  for (i = 0; i < cnt; i++)
+    if (blocks[i].pages != NULL)
+      palloc_free_multiple (blocks[i].pages, blocks[i].page_cnt);
+  largest = palloc_largest_free (0);
+  if (largest != initial)
+    fail ("largest free block is %zu pages after freeing all, "
+          "not %zu as at start", largest, initial);
+  msg ("PASS");
+}
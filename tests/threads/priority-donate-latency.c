@@ -0,0 +1,117 @@
+/* Measures lock handoff latency under priority inversion.
+
+   The main thread holds a lock that a high-priority thread is
+   waiting for, and wakes a medium-priority thread that hogs the
+   CPU for MEDIUM_SPIN_NS before going back to sleep.  Without
+   priority donation the medium thread preempts the lock holder,
+   so the high-priority thread waits for the whole spin; with
+   donation the holder keeps the CPU, releases the lock, and the
+   waiter runs right away.
+
+   Latency is measured with timer_ns() from the high-priority
+   thread's call to lock_acquire() until it returns, over ITERS
+   rounds, and the test fails if any round waited out the
+   medium thread's spin. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define ITERS 100
+#define MEDIUM_SPIN_NS (2 * 1000 * 1000)
+
+struct latency_info {
+  struct lock lock;               /* Lock handed from main to high. */
+  struct semaphore high_go;       /* Starts a round in high. */
+  struct semaphore medium_go;     /* Starts a round in medium. */
+  struct semaphore done;          /* Signals that high has finished. */
+  int64_t latency[ITERS];         /* Per-round handoff latency. */
+};
+
+static thread_func high_thread_func;
+static thread_func medium_thread_func;
+
+void
+test_priority_donate_latency (void) 
+{
+  struct latency_info info;
+  int64_t min, max, sum;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  lock_init (&info.lock);
+  sema_init (&info.high_go, 0);
+  sema_init (&info.medium_go, 0);
+  sema_init (&info.done, 0);
+  thread_create ("high", PRI_DEFAULT + 2, high_thread_func, &info);
+  thread_create ("medium", PRI_DEFAULT + 1, medium_thread_func, &info);
+
+  for (i = 0; i < ITERS; i++) 
+    {
+      lock_acquire (&info.lock);
+      sema_up (&info.high_go);
+      sema_up (&info.medium_go);
+      lock_release (&info.lock);
+    }
+  sema_down (&info.done);
+
+  min = max = sum = info.latency[0];
+  for (i = 1; i < ITERS; i++) 
+    {
+      if (info.latency[i] < min)
+        min = info.latency[i];
+      if (info.latency[i] > max)
+        max = info.latency[i];
+      sum += info.latency[i];
+    }
+  msg ("handoff latency over %d rounds: min %lld ns, avg %lld ns, max %lld ns",
+       ITERS, min, sum / ITERS, max);
+  if (max >= MEDIUM_SPIN_NS)
+    fail ("high waited %lld ns, at least the medium thread's %d ns spin",
+          max, MEDIUM_SPIN_NS);
+  msg ("PASS");
+}
+
+static void
+high_thread_func (void *info_) 
+{
+  struct latency_info *info = info_;
+  int i;
+
+  for (i = 0; i < ITERS; i++) 
+    {
+      int64_t start;
+
+      sema_down (&info->high_go);
+      start = timer_ns ();
+      lock_acquire (&info->lock);
+      info->latency[i] = timer_ns () - start;
+      lock_release (&info->lock);
+    }
+  sema_up (&info->done);
+}
+
+static void
+medium_thread_func (void *info_) 
+{
+  struct latency_info *info = info_;
+  int i;
+
+  for (i = 0; i < ITERS; i++) 
+    {
+      int64_t end;
+
+      sema_down (&info->medium_go);
+      end = timer_ns () + MEDIUM_SPIN_NS;
+      while (timer_ns () < end)
+        continue;
+    }
+}
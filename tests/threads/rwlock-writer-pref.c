@@ -0,0 +1,53 @@
+/* Tests reader/writer lock ordering.  The main thread holds the
+   lock for reading while a writer and then two readers queue up
+   behind it.  The readers must wait for the writer even though
+   the lock is only held for reading, and once the writer is done
+   both readers must be admitted together. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func writer_thread_func;
+static thread_func reader_thread_func;
+static struct rwlock rwlock;
+
+void
+test_rwlock_writer_pref (void) 
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rwlock);
+  rwlock_acquire_read (&rwlock);
+  thread_create ("writer", PRI_DEFAULT + 1, writer_thread_func, NULL);
+  thread_create ("reader 1", PRI_DEFAULT + 2, reader_thread_func, (void *) 1);
+  thread_create ("reader 2", PRI_DEFAULT + 3, reader_thread_func, (void *) 2);
+  msg ("main: releasing read lock.");
+  rwlock_release_read (&rwlock);
+  msg ("main: done.");
+}
+
+static void
+writer_thread_func (void *aux UNUSED) 
+{
+  rwlock_acquire_write (&rwlock);
+  msg ("writer: got the lock.");
+  rwlock_release_write (&rwlock);
+  msg ("writer: done.");
+}
+
+static void
+reader_thread_func (void *n_) 
+{
+  int n = (int) (uintptr_t) n_;
+
+  rwlock_acquire_read (&rwlock);
+  msg ("reader %d: got the lock with %u readers.", n, rwlock.readers);
+  rwlock_release_read (&rwlock);
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-writer-pref) begin
+(rwlock-writer-pref) main: releasing read lock.
+(rwlock-writer-pref) writer: got the lock.
+(rwlock-writer-pref) reader 2: got the lock with 2 readers.
+(rwlock-writer-pref) reader 1: got the lock with 1 readers.
+(rwlock-writer-pref) writer: done.
+(rwlock-writer-pref) main: done.
+(rwlock-writer-pref) end
+EOF
+pass;
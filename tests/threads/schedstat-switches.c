@@ -0,0 +1,55 @@
+/* Checks the per-thread context switch counts.  A higher-priority
+   thread blocks on a semaphore three times, so it must see exactly
+   three voluntary switches and no involuntary ones, while the main
+   thread is preempted each time it wakes the other thread up. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define BLOCK_CNT 3
+
+static thread_func blocker;
+static struct semaphore wakeup, done;
+static unsigned voluntary, involuntary;
+
+void
+test_schedstat_switches (void) 
+{
+  unsigned preempted;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&wakeup, 0);
+  sema_init (&done, 0);
+
+  preempted = thread_current ()->involuntary_switches;
+  thread_create ("blocker", PRI_DEFAULT + 1, blocker, NULL);
+  for (i = 0; i < BLOCK_CNT; i++)
+    sema_up (&wakeup);
+  sema_down (&done);
+  preempted = thread_current ()->involuntary_switches - preempted;
+
+  msg ("blocker: %u voluntary, %u involuntary switches.",
+       voluntary, involuntary);
+  if (preempted < BLOCK_CNT + 1)
+    fail ("main was preempted %u times, expected at least %d.",
+          preempted, BLOCK_CNT + 1);
+  msg ("main was preempted at least %d times.", BLOCK_CNT + 1);
+}
+
+static void
+blocker (void *aux UNUSED) 
+{
+  int i;
+
+  for (i = 0; i < BLOCK_CNT; i++)
+    sema_down (&wakeup);
+  voluntary = thread_current ()->voluntary_switches;
+  involuntary = thread_current ()->involuntary_switches;
+  sema_up (&done);
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(schedstat-switches) begin
+(schedstat-switches) blocker: 3 voluntary, 0 involuntary switches.
+(schedstat-switches) main was preempted at least 4 times.
+(schedstat-switches) end
+EOF
+pass;
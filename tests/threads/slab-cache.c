@@ -0,0 +1,111 @@
+/* Checks the slab allocator.  Allocates objects of an odd size
+   from a cache with a constructor, verifies that they do not
+   overlap and are packed more tightly than malloc() would pack
+   them, and that objects freed with either kmem_cache_free() or
+   free() are reused without being constructed again.  One object
+   per slab stays allocated throughout, so that no slab becomes
+   empty and is given back to the page allocator, which would
+   make the reallocations construct fresh objects. */
+
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/vaddr.h"
+
+#define OBJ_SIZE 552            /* Object size, in bytes. */
+#define OBJ_CNT 20              /* Objects allocated. */
+#define OBJ_MAGIC 0x0b1ec7      /* Set by the constructor. */
+
+struct obj 
+  {
+    int magic;
+    char data[OBJ_SIZE - sizeof (int)];
+  };
+
+static int ctor_cnt;
+
+static void
+obj_ctor (void *obj_) 
+{
+  struct obj *obj = obj_;
+
+  obj->magic = OBJ_MAGIC;
+  ctor_cnt++;
+}
+
+void
+test_slab_cache (void) 
+{
+  struct kmem_cache *cache;
+  struct obj *objs[OBJ_CNT];
+  void *pages[OBJ_CNT];
+  bool kept[OBJ_CNT];
+  int page_cnt, i, j, ctors, freed;
+
+  cache = kmem_cache_create ("slab-cache", sizeof (struct obj), 0, obj_ctor);
+  ASSERT (cache != NULL);
+
+  /* Allocate, and check that each object is constructed and that
+     no two overlap. */
+  page_cnt = 0;
+  for (i = 0; i < OBJ_CNT; i++) 
+    {
+      objs[i] = kmem_cache_alloc (cache);
+      if (objs[i] == NULL)
+        fail ("allocation %d failed", i);
+      if (objs[i]->magic != OBJ_MAGIC)
+        fail ("object %d not constructed", i);
+      for (j = 0; j < i; j++)
+        if ((char *) objs[i] < (char *) objs[j] + sizeof (struct obj)
+            && (char *) objs[j] < (char *) objs[i] + sizeof (struct obj))
+          fail ("objects %d and %d overlap", j, i);
+      memset (objs[i]->data, i, sizeof objs[i]->data);
+
+      for (j = 0; j < page_cnt; j++)
+        if (pages[j] == pg_round_down (objs[i]))
+          break;
+      kept[i] = j == page_cnt;
+      if (j == page_cnt)
+        pages[page_cnt++] = pg_round_down (objs[i]);
+    }
+  msg ("allocated %d objects of %d bytes.", OBJ_CNT, OBJ_SIZE);
+
+  /* malloc() would put 3 of these objects in each page. */
+  if (page_cnt >= DIV_ROUND_UP (OBJ_CNT, 3))
+    fail ("%d objects took %d pages", OBJ_CNT, page_cnt);
+  msg ("objects packed more tightly than malloc() packs them.");
+
+  /* Free all but the first object in each slab, alternating
+     between kmem_cache_free() and free(), then allocate as many
+     again.  No constructor may run. */
+  ctors = ctor_cnt;
+  freed = 0;
+  for (i = 0; i < OBJ_CNT; i++) 
+    {
+      if (objs[i]->data[0] != (char) i)
+        fail ("object %d corrupted", i);
+      if (kept[i])
+        continue;
+      if (freed++ % 2)
+        kmem_cache_free (cache, objs[i]);
+      else
+        free (objs[i]);
+      objs[i] = NULL;
+    }
+  for (i = 0; i < OBJ_CNT; i++) 
+    if (!kept[i])
+      {
+        objs[i] = kmem_cache_alloc (cache);
+        if (objs[i] == NULL || objs[i]->magic != OBJ_MAGIC)
+          fail ("reallocation %d failed", i);
+      }
+  if (ctor_cnt != ctors)
+    fail ("%d constructor calls for reused objects", ctor_cnt - ctors);
+  msg ("freed objects reused without construction.");
+
+  for (i = 0; i < OBJ_CNT; i++)
+    kmem_cache_free (cache, objs[i]);
+}
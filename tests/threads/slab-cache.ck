@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(slab-cache) begin
+(slab-cache) allocated 20 objects of 552 bytes.
+(slab-cache) objects packed more tightly than malloc() packs them.
+(slab-cache) freed objects reused without construction.
+(slab-cache) end
+EOF
+pass;
@@ -0,0 +1,79 @@
+/* Benchmark for strlen(), strchr(), memchr(), memcmp() and
+   strcmp().  Times each on strings from 16 bytes to 4 kB, and
+   reports TSC cycles per call and bytes per cycle.  The strings
+   start one byte past a word boundary so that the scans have a
+   partial first word to handle. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+#define BYTES_PER_SIZE (1 << 22) /* Bytes scanned per size and call. */
+
+static const size_t sizes[] = { 16, 64, 256, 1024, 4000 };
+
+/* Sink for results, so that calls aren't optimized away. */
+static volatile size_t sink;
+
+/* Returns the TSC cycles per call of function OP on the SIZE-byte
+   strings A and B, which are equal. */
+static uint64_t
+time_op (int op, const char *a, const char *b, size_t size) 
+{
+  size_t cnt = BYTES_PER_SIZE / size;
+  uint64_t start;
+  size_t i;
+
+  start = rdtsc ();
+  for (i = 0; i < cnt; i++)
+    switch (op) 
+      {
+      case 0: sink = strlen (a); break;
+      case 1: sink = (size_t) strchr (a, '!'); break;
+      case 2: sink = (size_t) memchr (a, '!', size); break;
+      case 3: sink = memcmp (a, b, size); break;
+      default: sink = strcmp (a, b); break;
+      }
+  return (rdtsc () - start) / cnt;
+}
+
+void
+test_string_bench (void) 
+{
+  static const char *names[] = {
+    "strlen", "strchr", "memchr", "memcmp", "strcmp",
+  };
+  uint8_t *pa, *pb;
+  size_t i;
+  int op;
+
+  pa = palloc_get_page (0);
+  pb = palloc_get_page (0);
+  if (pa == NULL || pb == NULL)
+    fail ("out of pages");
+
+  for (op = 0; op < 5; op++)
+    for (i = 0; i < sizeof sizes / sizeof *sizes; i++) 
+      {
+        char *a = (char *) pa + 1;
+        char *b = (char *) pb + 1;
+        uint64_t cycles;
+
+        memset (a, 'a', sizes[i]);
+        a[sizes[i]] = '\0';
+        memcpy (b, a, sizes[i] + 1);
+
+        cycles = time_op (op, a, b, sizes[i]);
+        msg ("%s %4zu bytes: %llu cycles, %llu.%02llu bytes/cycle",
+             names[op], sizes[i], cycles,
+             sizes[i] / (cycles ? cycles : 1),
+             sizes[i] * 100 / (cycles ? cycles : 1) % 100);
+      }
+
+  palloc_free_page (pa);
+  palloc_free_page (pb);
+  msg ("PASS");
+}
@@ -0,0 +1,148 @@
+/* Checks strlen(), strnlen(), strchr(), memchr(), memcmp() and
+   strcmp(), which scan a word at a time, against plain byte
+   loops.  Places random strings at random alignments, many of
+   them ending at the last byte of a page, and uses bytes with
+   the top bit set, which trip up careless zero-byte tests. */
+
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+#define ROUNDS 20000
+#define MAX_LEN 200
+
+/* The "no limit" bound that printf() passes to strnlen().
+   Volatile, as printf()'s is not a constant, so that the
+   compiler does not warn about the bound. */
+static volatile size_t no_limit = (size_t) -1;
+
+static size_t
+ref_strlen (const char *s) 
+{
+  size_t n = 0;
+  while (s[n] != '\0')
+    n++;
+  return n;
+}
+
+static int
+ref_memcmp (const unsigned char *a, const unsigned char *b, size_t n) 
+{
+  for (; n-- > 0; a++, b++)
+    if (*a != *b)
+      return *a > *b ? 1 : -1;
+  return 0;
+}
+
+static int
+ref_strcmp (const unsigned char *a, const unsigned char *b) 
+{
+  while (*a != '\0' && *a == *b)
+    a++, b++;
+  return *a < *b ? -1 : *a > *b;
+}
+
+static int
+sign (int x) 
+{
+  return x < 0 ? -1 : x > 0;
+}
+
+/* Fills LEN bytes at S with random nonzero bytes, each either
+   from a small alphabet or from the whole byte range. */
+static void
+fill (char *s, size_t len, bool wide) 
+{
+  size_t i;
+
+  for (i = 0; i < len; i++)
+    s[i] = wide ? random_ulong () % 255 + 1 : random_ulong () % 3 + 1;
+}
+
+/* Returns a place for a LEN-byte string and its null in PAGE:
+   usually so that the null is the page's last byte, otherwise
+   at a random offset. */
+static char *
+place (uint8_t *page, size_t len) 
+{
+  if (random_ulong () % 2)
+    return (char *) page + PGSIZE - len - 1;
+  return (char *) page + random_ulong () % (PGSIZE - len - 1);
+}
+
+void
+test_string_fuzz (void) 
+{
+  uint8_t *pa, *pb;
+  int round;
+
+  pa = palloc_get_page (0);
+  pb = palloc_get_page (0);
+  if (pa == NULL || pb == NULL)
+    fail ("out of pages");
+
+  random_init (0);
+  for (round = 0; round < ROUNDS; round++) 
+    {
+      bool wide = round % 2;
+      size_t la = random_ulong () % MAX_LEN;
+      size_t lb = random_ulong () % MAX_LEN;
+      char *a = place (pa, la);
+      char *b = place (pb, lb);
+      size_t i, n, maxlen;
+      int c;
+
+      fill (a, la, wide);
+      a[la] = '\0';
+      fill (b, lb, wide);
+      b[lb] = '\0';
+
+      /* Make B share a prefix with A most of the time. */
+      for (i = 0; i < la && i < lb && random_ulong () % 16; i++)
+        b[i] = a[i];
+
+      if (strlen (a) != ref_strlen (a))
+        fail ("round %d: strlen returned %zu, not %zu",
+              round, strlen (a), ref_strlen (a));
+
+      maxlen = random_ulong () % (la + 2);
+      if (strnlen (a, maxlen) != (la < maxlen ? la : maxlen))
+        fail ("round %d: strnlen of %zu bytes with limit %zu wrong",
+              round, la, maxlen);
+
+      /* A bound of NO_LIMIT must not wrap the end pointer. */
+      if (strnlen (a, no_limit) != la)
+        fail ("round %d: strnlen of %zu bytes with no limit wrong",
+              round, la);
+      if (memchr (a, '\0', no_limit) != a + la)
+        fail ("round %d: memchr for null with no limit wrong", round);
+
+      c = wide ? (int) (random_ulong () % 256) : (int) (random_ulong () % 4);
+      for (i = 0; (uint8_t) a[i] != c && a[i] != '\0'; i++)
+        continue;
+      if (strchr (a, c) != ((uint8_t) a[i] == c ? a + i : NULL))
+        fail ("round %d: strchr for %d wrong", round, c);
+
+      n = random_ulong () % (la + 2);
+      for (i = 0; i < n && (uint8_t) a[i] != c; i++)
+        continue;
+      if (memchr (a, c, n) != (i < n ? a + i : NULL))
+        fail ("round %d: memchr for %d in %zu bytes wrong", round, c, n);
+
+      if (sign (strcmp (a, b))
+          != ref_strcmp ((unsigned char *) a, (unsigned char *) b))
+        fail ("round %d: strcmp wrong", round);
+
+      n = la < lb ? la : lb;
+      if (sign (memcmp (a, b, n))
+          != ref_memcmp ((unsigned char *) a, (unsigned char *) b, n))
+        fail ("round %d: memcmp of %zu bytes wrong", round, n);
+    }
+  msg ("%d rounds correct.", ROUNDS);
+
+  palloc_free_page (pa);
+  palloc_free_page (pb);
+}
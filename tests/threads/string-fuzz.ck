@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(string-fuzz) begin
+(string-fuzz) 20000 rounds correct.
+(string-fuzz) end
+EOF
+pass;
@@ -0,0 +1,88 @@
+/* Measures the cost of a context switch in TSC cycles.
+
+   Two threads of equal priority hand control back and forth
+   through a pair of semaphores, so that every iteration performs
+   two voluntary switches.  The loop is timed once through the
+   callee-saved switch_threads() path and once through the full
+   intr_frame save and iretq of thread_launch(), so both numbers
+   come from the same boot on the same machine. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "intrinsic.h"
+
+#define ITERS 10000
+
+struct pingpong 
+  {
+    struct semaphore ping;        /* Upped by main, downed by pong. */
+    struct semaphore pong;        /* Upped by pong, downed by main. */
+  };
+
+static thread_func pong_thread_func;
+static uint64_t measure (bool iret_switch);
+
+void
+test_switch_pingpong (void) 
+{
+  uint64_t fast, slow;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  fast = measure (false);
+  slow = measure (true);
+  msg ("callee-saved switch: %llu cycles", fast);
+  msg ("intr_frame switch: %llu cycles", slow);
+  msg ("PASS");
+}
+
+/* Runs the ping-pong loop with thread_iret_switch set to
+   IRET_SWITCH and returns the average cycles per switch. */
+static uint64_t
+measure (bool iret_switch) 
+{
+  struct pingpong pp;
+  uint64_t start, end;
+  int i;
+
+  sema_init (&pp.ping, 0);
+  sema_init (&pp.pong, 0);
+  thread_iret_switch = iret_switch;
+  thread_create ("pong", thread_get_priority (), pong_thread_func, &pp);
+
+  /* Let pong reach its first sema_down() before timing. */
+  sema_up (&pp.ping);
+  sema_down (&pp.pong);
+
+  start = rdtsc ();
+  for (i = 0; i < ITERS; i++) 
+    {
+      sema_up (&pp.ping);
+      sema_down (&pp.pong);
+    }
+  end = rdtsc ();
+
+  /* Wait for pong to exit. */
+  sema_up (&pp.ping);
+  sema_down (&pp.pong);
+  thread_iret_switch = false;
+
+  return (end - start) / (2 * ITERS);
+}
+
+static void
+pong_thread_func (void *pp_) 
+{
+  struct pingpong *pp = pp_;
+  int i;
+
+  for (i = 0; i < ITERS + 2; i++) 
+    {
+      sema_down (&pp->ping);
+      sema_up (&pp->pong);
+    }
+}
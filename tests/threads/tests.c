@@ -25,6 +25,21 @@ static const struct test tests[] =
     {"priority-donate-sema", test_priority_donate_sema},
     {"priority-donate-lower", test_priority_donate_lower},
     {"priority-donate-chain", test_priority_donate_chain},
+    {"priority-donate-latency", test_priority_donate_latency},
+    {"switch-pingpong", test_switch_pingpong},
+    {"rwlock-writer-pref", test_rwlock_writer_pref},
+    {"thread-churn", test_thread_churn},
+    {"workqueue-order", test_workqueue_order},
+    {"schedstat-switches", test_schedstat_switches},
+    {"edf-load", test_edf_load},
+    {"edf-overrun", test_edf_overrun},
+    {"palloc-frag", test_palloc_frag},
+    {"slab-cache", test_slab_cache},
+    {"malloc-realloc", test_malloc_realloc},
+    {"mmu-large-page", test_mmu_large_page},
+    {"memcpy-bench", test_memcpy_bench},
+    {"string-bench", test_string_bench},
+    {"string-fuzz", test_string_fuzz},
     {"priority-fifo", test_priority_fifo},
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
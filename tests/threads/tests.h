@@ -19,6 +19,21 @@ extern test_func test_priority_donate_sema;
 extern test_func test_priority_donate_nest;
 extern test_func test_priority_donate_lower;
 extern test_func test_priority_donate_chain;
+extern test_func test_priority_donate_latency;
+extern test_func test_switch_pingpong;
+extern test_func test_rwlock_writer_pref;
+extern test_func test_thread_churn;
+extern test_func test_workqueue_order;
+extern test_func test_schedstat_switches;
+extern test_func test_edf_load;
+extern test_func test_edf_overrun;
+extern test_func test_palloc_frag;
+extern test_func test_slab_cache;
+extern test_func test_malloc_realloc;
+extern test_func test_mmu_large_page;
+extern test_func test_memcpy_bench;
+extern test_func test_string_bench;
+extern test_func test_string_fuzz;
 extern test_func test_priority_fifo;
 extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
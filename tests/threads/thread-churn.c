@@ -0,0 +1,52 @@
+/* Fork-bomb style thread churn.  Every thread creates two
+   children, down to DEPTH generations, and exits right away, so
+   thread creation and destruction dominate the run time.  Reports
+   the average cost of a thread's whole life in TSC cycles. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "intrinsic.h"
+
+#define DEPTH 9
+#define THREAD_CNT ((1 << (DEPTH + 1)) - 2)
+
+static thread_func churn_thread;
+static struct semaphore done;
+
+void
+test_thread_churn (void) 
+{
+  uint64_t start, end;
+  int i;
+
+  sema_init (&done, 0);
+
+  start = rdtsc ();
+  thread_create ("churn", PRI_DEFAULT, churn_thread, (void *) 1);
+  thread_create ("churn", PRI_DEFAULT, churn_thread, (void *) 1);
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+  end = rdtsc ();
+
+  msg ("%d threads, %llu cycles per thread", THREAD_CNT,
+       (end - start) / THREAD_CNT);
+  msg ("PASS");
+}
+
+static void
+churn_thread (void *depth_) 
+{
+  int depth = (int) (uintptr_t) depth_;
+
+  if (depth < DEPTH) 
+    {
+      void *aux = (void *) (uintptr_t) (depth + 1);
+      if (thread_create ("churn", PRI_DEFAULT, churn_thread, aux) == TID_ERROR
+          || thread_create ("churn", PRI_DEFAULT, churn_thread, aux) == TID_ERROR)
+        fail ("thread_create failed at depth %d", depth);
+    }
+  sema_up (&done);
+}
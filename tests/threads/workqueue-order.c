@@ -0,0 +1,65 @@
+/* Queues work items on a single-worker workqueue from a context
+   with interrupts off, as an interrupt handler would, and checks
+   that they run once each, in FIFO order, that scheduling a
+   pending item is a no-op, and that an item may requeue itself.
+   The worker runs below the main thread's priority, so nothing
+   runs until workqueue_flush() blocks. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+#include "threads/workqueue.h"
+
+#define REQUEUE_CNT 3
+
+static work_func record_work, requeue_work;
+
+static struct workqueue *wq;
+
+void
+test_workqueue_order (void) 
+{
+  struct work works[3], requeue;
+  enum intr_level old_level;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  wq = workqueue_create ("test", PRI_DEFAULT - 1, 1);
+  ASSERT (wq != NULL);
+
+  for (i = 0; i < 3; i++)
+    work_init (&works[i], record_work, (void *) (intptr_t) i);
+  work_init (&requeue, requeue_work, &requeue);
+
+  old_level = intr_disable ();
+  for (i = 0; i < 3; i++)
+    schedule_work (wq, &works[i]);
+  if (!schedule_work (wq, &works[1]))
+    msg ("schedule_work on a pending item returned false.");
+  schedule_work (wq, &requeue);
+  intr_set_level (old_level);
+
+  msg ("main: flushing.");
+  workqueue_flush (wq);
+  msg ("main: flush returned.");
+}
+
+static void
+record_work (void *aux) 
+{
+  msg ("work %d ran.", (int) (intptr_t) aux);
+}
+
+static void
+requeue_work (void *w) 
+{
+  static int runs;
+
+  msg ("requeue: run %d.", ++runs);
+  if (runs < REQUEUE_CNT && !schedule_work (wq, w))
+    fail ("requeue: could not reschedule itself.");
+}
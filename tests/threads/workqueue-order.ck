@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(workqueue-order) begin
+(workqueue-order) schedule_work on a pending item returned false.
+(workqueue-order) main: flushing.
+(workqueue-order) work 0 ran.
+(workqueue-order) work 1 ran.
+(workqueue-order) work 2 ran.
+(workqueue-order) requeue: run 1.
+(workqueue-order) requeue: run 2.
+(workqueue-order) requeue: run 3.
+(workqueue-order) main: flush returned.
+(workqueue-order) end
+EOF
+pass;
@@ -0,0 +1,77 @@
+/* Splits a sum over an array among several threads of one
+   process.  The workers read the array and add their partial sums
+   to a shared total under a mutex, all in the address space they
+   share with the main thread: nothing is copied, unlike with
+   fork().  Reports how many cycles creating, running and joining
+   the workers took.
+
+   Like the rest of the userprog tests, this relies on the exit
+   and write system calls, so it fails until those are
+   implemented. */
+
+#include <synch.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define WORKERS 8
+#define SLICE 4096
+
+static int data[WORKERS * SLICE];
+static long long total;
+static struct mutex total_lock = MUTEX_INITIALIZER;
+
+static inline unsigned long long
+rdtsc (void)
+{
+  unsigned int lo, hi;
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((unsigned long long) hi << 32) | lo;
+}
+
+static void
+worker (void *slice_)
+{
+  int slice = (int) (long) slice_;
+  long long sum = 0;
+  int i;
+
+  for (i = slice * SLICE; i < (slice + 1) * SLICE; i++)
+    sum += data[i];
+
+  mutex_lock (&total_lock);
+  total += sum;
+  mutex_unlock (&total_lock);
+}
+
+void
+test_main (void)
+{
+  tid_t tids[WORKERS];
+  unsigned long long start, end;
+  long long expected = 0;
+  int i;
+
+  for (i = 0; i < WORKERS * SLICE; i++)
+    {
+      data[i] = i;
+      expected += i;
+    }
+
+  start = rdtsc ();
+  for (i = 0; i < WORKERS; i++)
+    {
+      tids[i] = uthread_create (worker, (void *) (long) i);
+      if (tids[i] == TID_ERROR)
+        fail ("uthread_create #%d failed", i);
+    }
+  for (i = 0; i < WORKERS; i++)
+    if (uthread_join (tids[i]) != 0)
+      fail ("uthread_join #%d failed", i);
+  end = rdtsc ();
+
+  msg ("%d workers took %llu cycles", WORKERS, end - start);
+  if (total != expected)
+    fail ("sum is %lld, expected %lld", total, expected);
+  msg ("sum matches");
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing sum check in output"
+  unless grep ($_ eq '(uthread-workers) sum matches', @output);
+fail "missing exit(0)"
+  unless grep ($_ eq 'uthread-workers: exit(0)', @output);
+
+pass;
@@ -0,0 +1,243 @@
+#include "threads/fpu.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "intrinsic.h"
+
+/* Lazy FPU context switching.
+
+   The x87, SSE and (where XSAVE is available) AVX registers are
+   not saved on every thread switch.  Instead, schedule() sets
+   CR0.TS whenever the incoming thread is not the one whose state
+   is loaded in the registers, the "owner".  The first FPU or SSE
+   instruction that thread executes raises #NM, and only then do
+   we save the owner's state into its save area and load the
+   current thread's.  A thread that runs again before anyone else
+   touches the FPU finds its state still loaded and pays nothing,
+   and threads that never use the FPU never get a save area.
+
+   The kernel itself is built with -mno-sse -msoft-float, so only
+   user code ever traps here. */
+
+/* CR0 bits. */
+#define CR0_MP (1 << 1)                 /* Monitor coprocessor. */
+#define CR0_EM (1 << 2)                 /* x87 emulation. */
+#define CR0_TS (1 << 3)                 /* Task switched. */
+#define CR0_NE (1 << 5)                 /* Native x87 error reporting. */
+
+/* CR4 bits. */
+#define CR4_OSFXSR (1 << 9)             /* FXSAVE/FXRSTOR and SSE. */
+#define CR4_OSXMMEXCPT (1 << 10)        /* Unmasked SSE exceptions. */
+#define CR4_OSXSAVE (1 << 18)           /* XSAVE and XCR0. */
+
+/* XCR0 state components that we manage. */
+#define XSTATE_X87 (1 << 0)
+#define XSTATE_SSE (1 << 1)
+#define XSTATE_AVX (1 << 2)
+
+/* XSAVE areas must be 64-byte aligned, FXSAVE areas 16-byte. */
+#define FPU_ALIGN 64
+
+/* Initial MXCSR: all SSE exceptions masked, round to nearest. */
+#define MXCSR_DEFAULT 0x1f80
+
+static bool use_xsave;                  /* XSAVE rather than FXSAVE? */
+static size_t fpu_size;                 /* Bytes in a save area. */
+static void *fpu_initial;               /* Clean state for new users. */
+static struct thread *fpu_owner;        /* State in the registers. */
+static bool fpu_ts;                     /* Last value written to CR0.TS. */
+
+static void fpu_trap (struct intr_frame *);
+static void *fpu_area (void *);
+static void *fpu_alloc (void);
+static void fpu_save (void *);
+static void fpu_restore (const void *);
+static void set_ts (bool);
+
+/* Enables the FPU and SSE for user programs, picks FXSAVE or
+   XSAVE, captures the clean FPU state and installs the #NM
+   handler.  Must be called after malloc_init(). */
+void
+fpu_init (void) {
+	static const uint32_t mxcsr = MXCSR_DEFAULT;
+	uint32_t eax, ebx, ecx, edx;
+
+	cpuid (1, 0, &eax, &ebx, &ecx, &edx);
+	ASSERT (edx & (1 << 24));           /* FXSR, architectural on x86-64. */
+
+	lcr0 ((rcr0 () & ~(CR0_EM | CR0_TS)) | CR0_MP | CR0_NE);
+	lcr4 (rcr4 () | CR4_OSFXSR | CR4_OSXMMEXCPT);
+
+	fpu_size = 512;
+	if (ecx & (1 << 26)) {              /* XSAVE. */
+		uint64_t xcr0 = XSTATE_X87 | XSTATE_SSE;
+
+		if (ecx & (1 << 28))            /* AVX. */
+			xcr0 |= XSTATE_AVX;
+		lcr4 (rcr4 () | CR4_OSXSAVE);
+		xsetbv (0, xcr0);
+
+		/* EBX now gives the size needed for the enabled components. */
+		cpuid (0xd, 0, &eax, &ebx, &ecx, &edx);
+		fpu_size = ebx;
+		use_xsave = true;
+	}
+
+	fpu_initial = fpu_alloc ();
+	if (fpu_initial == NULL)
+		PANIC ("fpu_init: out of memory");
+	__asm __volatile ("fninit");
+	__asm __volatile ("ldmxcsr %0" : : "m" (mxcsr));
+	fpu_save (fpu_area (fpu_initial));
+
+	set_ts (true);
+	intr_register_int (7, 0, INTR_ON, fpu_trap,
+			"#NM Device Not Available Exception");
+	printf ("FPU: %s, %zu-byte save area.\n",
+			use_xsave ? "XSAVE" : "FXSAVE", fpu_size);
+}
+
+/* Called by schedule() just before switching to NEXT, with
+   interrupts off.  Lets NEXT use the registers without trapping
+   if they already hold its state. */
+void
+fpu_switch (struct thread *next) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (fpu_size != 0)
+		set_ts (next != fpu_owner);
+}
+
+/* Gives CHILD a copy of PARENT's FPU state, if PARENT has any.
+   Called in CHILD's context.  Returns false if memory for the
+   copy could not be allocated. */
+bool
+fpu_fork (struct thread *child, struct thread *parent) {
+	enum intr_level old_level;
+	void *fpu;
+
+	if (parent->fpu == NULL)
+		return true;
+
+	fpu = fpu_alloc ();
+	if (fpu == NULL)
+		return false;
+
+	old_level = intr_disable ();
+	if (fpu_owner == parent) {
+		/* PARENT's newest state is still in the registers. */
+		set_ts (false);
+		fpu_save (fpu_area (parent->fpu));
+		set_ts (child != fpu_owner);
+	}
+	child->fpu = fpu;
+	memcpy (fpu_area (child->fpu), fpu_area (parent->fpu), fpu_size);
+	intr_set_level (old_level);
+	return true;
+}
+
+/* Discards T's FPU state.  Called when a process exits or
+   replaces its image, so that the next program starts from a
+   clean FPU. */
+void
+fpu_release (struct thread *t) {
+	enum intr_level old_level;
+	void *fpu;
+
+	old_level = intr_disable ();
+	if (fpu_owner == t) {
+		fpu_owner = NULL;
+		if (t == thread_current ())
+			set_ts (true);
+	}
+	fpu = t->fpu;
+	t->fpu = NULL;
+	intr_set_level (old_level);
+
+	free (fpu);
+}
+
+/* #NM handler: the running thread touched the FPU while CR0.TS
+   was set.  Saves the owner's state and loads ours. */
+static void
+fpu_trap (struct intr_frame *f) {
+	struct thread *cur = thread_current ();
+	enum intr_level old_level;
+
+	if ((f->cs & 3) == 0)
+		PANIC ("Kernel used the FPU at rip=%llx", f->rip);
+
+	if (cur->fpu == NULL) {
+		void *fpu = fpu_alloc ();
+
+		if (fpu == NULL) {
+			printf ("%s: out of memory for FPU state\n", thread_name ());
+			thread_exit ();
+		}
+		memcpy (fpu_area (fpu), fpu_area (fpu_initial), fpu_size);
+		cur->fpu = fpu;
+	}
+
+	old_level = intr_disable ();
+	set_ts (false);
+	if (fpu_owner != cur) {
+		if (fpu_owner != NULL)
+			fpu_save (fpu_area (fpu_owner->fpu));
+		fpu_restore (fpu_area (cur->fpu));
+		fpu_owner = cur;
+	}
+	intr_set_level (old_level);
+}
+
+/* Returns the save area inside BLOCK, a block from fpu_alloc(). */
+static void *
+fpu_area (void *block) {
+	return (void *) ROUND_UP ((uintptr_t) block, FPU_ALIGN);
+}
+
+/* Allocates a block large enough for an aligned, zeroed save
+   area.  XRSTOR requires the reserved bytes of the XSAVE header
+   to be zero, which XSAVE itself never writes. */
+static void *
+fpu_alloc (void) {
+	return calloc (1, fpu_size + FPU_ALIGN - 1);
+}
+
+/* Saves the FPU registers into AREA. */
+static void
+fpu_save (void *area) {
+	if (use_xsave)
+		__asm __volatile ("xsave64 (%0)"
+				: : "r" (area), "a" (-1), "d" (-1) : "memory");
+	else
+		__asm __volatile ("fxsave64 (%0)" : : "r" (area) : "memory");
+}
+
+/* Loads the FPU registers from AREA. */
+static void
+fpu_restore (const void *area) {
+	if (use_xsave)
+		__asm __volatile ("xrstor64 (%0)"
+				: : "r" (area), "a" (-1), "d" (-1) : "memory");
+	else
+		__asm __volatile ("fxrstor64 (%0)" : : "r" (area) : "memory");
+}
+
+/* Sets CR0.TS to TS, skipping the write if it already has that
+   value.  Must be called with interrupts off or before
+   interrupts are enabled. */
+static void
+set_ts (bool ts) {
+	if (ts == fpu_ts)
+		return;
+	if (ts)
+		lcr0 (rcr0 () | CR0_TS);
+	else
+		clts ();
+	fpu_ts = ts;
+}
@@ -10,17 +10,26 @@
 #include <string.h>
 #include "devices/kbd.h"
 #include "devices/input.h"
+#include "devices/lapic.h"
 #include "devices/serial.h"
 #include "devices/timer.h"
 #include "devices/vga.h"
+#include "threads/fpu.h"
 #include "threads/interrupt.h"
+#include "threads/lockstat.h"
 #include "threads/io.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/mmu.h"
 #include "threads/palloc.h"
+#include "threads/pcid.h"
+#include "threads/profile.h"
+#include "threads/schedstat.h"
 #include "threads/pte.h"
 #include "threads/thread.h"
+#include "threads/workqueue.h"
+#include "intrinsic.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -72,6 +81,7 @@ main (void) {
 
 	/* Clear BSS and get machine's RAM size. */
 	bss_init ();
+	string_init ();
 
 	/* Break command line into arguments and parse options. */
 	argv = read_command_line ();
@@ -85,7 +95,11 @@ main (void) {
 	/* Initialize memory system. */
 	mem_end = palloc_init ();
 	malloc_init ();
+	slab_init ();
+	profile_init ();
+	schedstat_init ();
 	paging_init (mem_end);
+	pcid_init ();
 
 #ifdef USERPROG
 	tss_init ();
@@ -94,15 +108,18 @@ main (void) {
 
 	/* Initialize interrupt handlers. */
 	intr_init ();
+	lapic_init ();
 	timer_init ();
 	kbd_init ();
 	input_init ();
+	fpu_init ();
 #ifdef USERPROG
 	exception_init ();
 	syscall_init ();
 #endif
 	/* Start thread scheduler and enable interrupts. */
 	thread_start ();
+	workqueue_init ();
 	serial_init_queue ();
 	timer_calibrate ();
 
@@ -140,26 +157,66 @@ bss_init (void) {
 	memset (&_start_bss, 0, &_end_bss - &_start_bss);
 }
 
+/* Returns the size of the largest page that can map physical
+ * address PA in the kernel's direct map of [0, MEM_END): one that
+ * is aligned in both physical and virtual memory, lies below
+ * MEM_END, and, unless it is a 4 kB page, holds no kernel text,
+ * which must be mapped read-only. */
+static size_t
+direct_map_size (uint64_t pa, uint64_t mem_end, bool huge_ok) {
+	extern char start, _end_kernel_text;
+	uint64_t text_start = vtop (&start);
+	uint64_t text_end = vtop (&_end_kernel_text);
+	size_t sizes[] = { HUGE_PAGE_SIZE, LARGE_PAGE_SIZE };
+	size_t i;
+
+	for (i = huge_ok ? 0 : 1; i < sizeof sizes / sizeof *sizes; i++) {
+		size_t size = sizes[i];
+
+		if (pa % size == 0 && (uint64_t) ptov (pa) % size == 0
+				&& pa + size <= mem_end
+				&& (pa + size <= text_start || pa >= text_end))
+			return size;
+	}
+	return PGSIZE;
+}
+
 /* Populates the page table with the kernel virtual mapping,
  * and then sets up the CPU to use the new page directory.
- * Points base_pml4 to the pml4 it creates. */
+ * Points base_pml4 to the pml4 it creates.
+ * Memory is mapped with 2 MiB pages, and 1 GiB pages if the CPU
+ * supports them, wherever alignment allows, to save page table
+ * memory and TLB entries.  The kernel's text gets 4 kB pages. */
 static void
 paging_init (uint64_t mem_end) {
 	uint64_t *pml4, *pte;
+	uint32_t eax, ebx, ecx, edx;
+	bool huge_ok = false;
+	size_t size;
 	int perm;
 	pml4 = base_pml4 = palloc_get_page (PAL_ASSERT | PAL_ZERO);
 
+	/* CPUID.80000001H:EDX bit 26 reports 1 GiB pages. */
+	cpuid (0x80000000, 0, &eax, &ebx, &ecx, &edx);
+	if (eax >= 0x80000001) {
+		cpuid (0x80000001, 0, &eax, &ebx, &ecx, &edx);
+		huge_ok = (edx & (1 << 26)) != 0;
+	}
+
 	extern char start, _end_kernel_text;
 	// Maps physical address [0 ~ mem_end] to
 	//   [LOADER_KERN_BASE ~ LOADER_KERN_BASE + mem_end].
-	for (uint64_t pa = 0; pa < mem_end; pa += PGSIZE) {
+	for (uint64_t pa = 0; pa < mem_end; pa += size) {
 		uint64_t va = (uint64_t) ptov(pa);
 
+		size = direct_map_size (pa, mem_end, huge_ok);
 		perm = PTE_P | PTE_W;
-		if ((uint64_t) &start <= va && va < (uint64_t) &_end_kernel_text)
+		if (size != PGSIZE)
+			perm |= PTE_PS;
+		else if ((uint64_t) &start <= va && va < (uint64_t) &_end_kernel_text)
 			perm &= ~PTE_W;
 
-		if ((pte = pml4e_walk (pml4, va, 1)) != NULL)
+		if ((pte = pml4e_walk_size (pml4, va, size)) != NULL)
 			*pte = pa | perm;
 	}
 
@@ -221,6 +278,15 @@ parse_options (char **argv) {
 			random_init (atoi (value));
 		else if (!strcmp (name, "-mlfqs"))
 			thread_mlfqs = true;
+		else if (!strcmp (name, "-lockstat"))
+			lockstat_enabled = true;
+		else if (!strcmp (name, "-schedstat"))
+			schedstat_enabled = true;
+		else if (!strcmp (name, "-profile")) {
+			profile_enabled = true;
+			if (value != NULL)
+				profile_depth = atoi (value);
+		}
 #ifdef USERPROG
 		else if (!strcmp (name, "-ul"))
 			user_page_limit = atoi (value);
@@ -326,6 +392,12 @@ usage (void) {
 			"  -f                 Format file system disk during startup.\n"
 			"  -rs=SEED           Set random number seed to SEED.\n"
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
+			"  -lockstat          Collect lock contention statistics.\n"
+			"  -schedstat         Report per-thread run times and scheduler\n"
+			"                     latency, and trace scheduling events.\n"
+			"  -profile[=DEPTH]   Sample the running code at each timer tick,\n"
+			"                     with up to DEPTH callers, and dump the\n"
+			"                     samples at power off.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
@@ -343,6 +415,8 @@ power_off (void) {
 #endif
 
 	print_stats ();
+	profile_dump ();
+	schedstat_dump ();
 
 	printf ("Powering off...\n");
 	outw (0x604, 0x2000);               /* Poweroff command for qemu */
@@ -354,6 +428,8 @@ static void
 print_stats (void) {
 	timer_print_stats ();
 	thread_print_stats ();
+	malloc_print_stats ();
+	kmem_cache_print_stats ();
 #ifdef FILESYS
 	disk_print_stats ();
 #endif
@@ -361,5 +437,7 @@ print_stats (void) {
 	kbd_print_stats ();
 #ifdef USERPROG
 	exception_print_stats ();
+	pml4_print_stats ();
+	pcid_print_stats ();
 #endif
 }
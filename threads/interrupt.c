@@ -9,6 +9,7 @@
 #include "threads/thread.h"
 #include "threads/mmu.h"
 #include "threads/vaddr.h"
+#include "devices/lapic.h"
 #include "devices/timer.h"
 #include "intrinsic.h"
 #ifdef USERPROG
@@ -18,6 +19,13 @@
 /* Number of x86_64 interrupts. */
 #define INTR_CNT 256
 
+/* External interrupt vectors.  0x20...0x2f are delivered by the
+   8259A PICs, 0x30...0x3f by the local APIC (see lapic.h). */
+#define EXT_FIRST   0x20
+#define EXT_LAPIC   0x30
+#define EXT_LAST    0x3f
+#define is_external(vec) ((vec) >= EXT_FIRST && (vec) <= EXT_LAST)
+
 /* Creates an gate that invokes FUNCTION.
 
    The gate has descriptor privilege level DPL, meaning that it
@@ -106,6 +114,7 @@ static bool yield_on_return;    /* Should we yield on interrupt return? */
 /* Programmable Interrupt Controller helpers. */
 static void pic_init (void);
 static void pic_end_of_interrupt (int irq);
+static void end_of_interrupt (int vec);
 
 /* Interrupt handlers. */
 void intr_handler (struct intr_frame *args);
@@ -227,10 +236,27 @@ register_handler (uint8_t vec_no, int dpl, enum intr_level level,
 void
 intr_register_ext (uint8_t vec_no, intr_handler_func *handler,
 		const char *name) {
-	ASSERT (vec_no >= 0x20 && vec_no <= 0x2f);
+	ASSERT (is_external (vec_no));
 	register_handler (vec_no, 0, INTR_OFF, handler, name);
 }
 
+/* Masks external interrupt VEC_NO at the 8259A PIC, for example
+   because another interrupt source has taken over its job. */
+void
+intr_mask_ext (uint8_t vec_no) {
+	enum intr_level old_level;
+	int irq = vec_no - EXT_FIRST;
+
+	ASSERT (vec_no >= EXT_FIRST && vec_no < EXT_LAPIC);
+
+	old_level = intr_disable ();
+	if (irq < 8)
+		outb (0x21, inb (0x21) | (1 << irq));
+	else
+		outb (0xa1, inb (0xa1) | (1 << (irq - 8)));
+	intr_set_level (old_level);
+}
+
 /* Registers internal interrupt VEC_NO to invoke HANDLER, which
    is named NAME for debugging purposes.  The interrupt handler
    will be invoked with interrupt status LEVEL.
@@ -248,7 +274,7 @@ void
 intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
 		intr_handler_func *handler, const char *name)
 {
-	ASSERT (vec_no < 0x20 || vec_no > 0x2f);
+	ASSERT (!is_external (vec_no));
 	register_handler (vec_no, dpl, level, handler, name);
 }
 
@@ -322,6 +348,16 @@ pic_end_of_interrupt (int irq) {
 	if (irq >= 0x28)
 		outb (0xa0, 0x20);
 }
+
+/* Acknowledges external interrupt VEC at whichever interrupt
+   controller delivered it. */
+static void
+end_of_interrupt (int vec) {
+	if (vec < EXT_LAPIC)
+		pic_end_of_interrupt (vec);
+	else
+		lapic_eoi ();
+}
 /* Interrupt handlers. */
 
 /* Handler for all interrupts, faults, and exceptions.  This
@@ -335,9 +371,10 @@ intr_handler (struct intr_frame *frame) {
 
 	/* External interrupts are special.
 	   We only handle one at a time (so interrupts must be off)
-	   and they need to be acknowledged on the PIC (see below).
-	   An external interrupt handler cannot sleep. */
-	external = frame->vec_no >= 0x20 && frame->vec_no < 0x30;
+	   and they need to be acknowledged on the PIC or the local
+	   APIC (see below).  An external interrupt handler cannot
+	   sleep. */
+	external = is_external (frame->vec_no);
 	if (external) {
 		ASSERT (intr_get_level () == INTR_OFF);
 		ASSERT (!intr_context ());
@@ -367,10 +404,10 @@ intr_handler (struct intr_frame *frame) {
 		ASSERT (intr_context ());
 
 		in_external_intr = false;
-		pic_end_of_interrupt (frame->vec_no);
+		end_of_interrupt (frame->vec_no);
 
 		if (yield_on_return)
-			thread_yield ();
+			thread_yield_preempted ();
 	}
 }
 
@@ -0,0 +1,149 @@
+#include "threads/lockstat.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "devices/timer.h"
+
+/* Lock contention statistics.
+
+   With -lockstat, every lock is attached at lock_init() to a
+   class named after the expression passed to lock_init(), so
+   that, for example, the locks of both disk channels are
+   counted together as "c->lock".  Locks that come and go with
+   the objects that contain them thus need no unregistering.
+   Plain sema_down() calls, which have no name, are all counted
+   in one "(semaphores)" class.
+
+   For each class we count acquisitions and contended
+   acquisitions, that is, those that had to sleep, and keep the
+   total time spent sleeping and the longest time the lock was
+   held, all in TSC cycles.  Counters are only updated with
+   interrupts off. */
+
+/* Maximum number of classes.  Locks initialized once this many
+   names are in use are counted in the overflow class. */
+#define LOCKSTAT_CLASSES 128
+
+struct lock_class {
+	const char *name;           /* Name passed to lock_init(). */
+	uint64_t acquired;          /* Number of acquisitions. */
+	uint64_t contended;         /* Acquisitions that had to sleep. */
+	uint64_t wait_cycles;       /* Total time spent sleeping. */
+	uint64_t max_hold_cycles;   /* Longest time held. */
+};
+
+bool lockstat_enabled;
+
+static struct lock_class classes[LOCKSTAT_CLASSES];
+static size_t class_cnt;
+static struct lock_class overflow_class = { .name = "(other)" };
+static struct lock_class sema_class = { .name = "(semaphores)" };
+
+/* Returns the class for locks named NAME, creating it if
+   needed.  A leading `&' is dropped from NAME. */
+struct lock_class *
+lockstat_class (const char *name) {
+	struct lock_class *c = NULL;
+	enum intr_level old_level;
+	size_t i;
+
+	ASSERT (name != NULL);
+
+	if (*name == '&')
+		name++;
+
+	old_level = intr_disable ();
+	for (i = 0; i < class_cnt; i++)
+		if (!strcmp (classes[i].name, name)) {
+			c = &classes[i];
+			break;
+		}
+	if (c == NULL) {
+		if (class_cnt < LOCKSTAT_CLASSES) {
+			c = &classes[class_cnt++];
+			c->name = name;
+		} else
+			c = &overflow_class;
+	}
+	intr_set_level (old_level);
+
+	return c;
+}
+
+/* Returns the class that counts plain sema_down() calls. */
+struct lock_class *
+lockstat_sema_class (void) {
+	return &sema_class;
+}
+
+/* Records an acquisition of a lock in class C, which slept for
+   WAIT_CYCLES if CONTENDED. */
+void
+lockstat_acquired (struct lock_class *c, bool contended,
+		uint64_t wait_cycles) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	c->acquired++;
+	if (contended) {
+		c->contended++;
+		c->wait_cycles += wait_cycles;
+	}
+}
+
+/* Records the release of a lock in class C after it was held
+   for HOLD_CYCLES. */
+void
+lockstat_released (struct lock_class *c, uint64_t hold_cycles) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (hold_cycles > c->max_hold_cycles)
+		c->max_hold_cycles = hold_cycles;
+}
+
+/* Returns true if class A should be listed before class B:
+   more time spent waiting, then more contended acquisitions,
+   then more acquisitions. */
+static bool
+hotter (const struct lock_class *a, const struct lock_class *b) {
+	if (a->wait_cycles != b->wait_cycles)
+		return a->wait_cycles > b->wait_cycles;
+	if (a->contended != b->contended)
+		return a->contended > b->contended;
+	return a->acquired > b->acquired;
+}
+
+/* Prints the TOP_N classes that spent the most time waiting. */
+void
+lockstat_print (int top_n) {
+	struct lock_class *all[LOCKSTAT_CLASSES + 2];
+	size_t cnt = 0;
+	size_t i, j;
+
+	for (i = 0; i < class_cnt; i++)
+		all[cnt++] = &classes[i];
+	all[cnt++] = &overflow_class;
+	all[cnt++] = &sema_class;
+
+	/* Insertion sort, hottest first.  There are few classes. */
+	for (i = 1; i < cnt; i++) {
+		struct lock_class *c = all[i];
+		for (j = i; j > 0 && hotter (c, all[j - 1]); j--)
+			all[j] = all[j - 1];
+		all[j] = c;
+	}
+
+	printf ("Lock statistics, top %d by wait time:\n", top_n);
+	printf ("  %-24s %10s %10s %12s %12s\n",
+			"name", "acquired", "contended", "wait us", "max hold us");
+	for (i = 0; i < cnt && i < (size_t) top_n; i++) {
+		const struct lock_class *c = all[i];
+		if (c->acquired == 0)
+			break;
+		printf ("  %-24s %10"PRIu64" %10"PRIu64" %12"PRId64" %12"PRId64"\n",
+				c->name, c->acquired, c->contended,
+				timer_cycles_to_ns (c->wait_cycles) / 1000,
+				timer_cycles_to_ns (c->max_hold_cycles) / 1000);
+	}
+}
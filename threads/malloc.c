@@ -6,16 +6,20 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/palloc.h"
+#include "threads/slab.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 
 /* A simple implementation of malloc().
 
-   The size of each request, in bytes, is rounded up to a power
-   of 2 and assigned to the "descriptor" that manages blocks of
-   that size.  The descriptor keeps a list of free blocks.  If
-   the free list is nonempty, one of its blocks is used to
-   satisfy the request.
+   The size of each request, in bytes, is rounded up to the next
+   size class and assigned to the "descriptor" that manages
+   blocks of that size.  The size classes are the powers of 2
+   from 16 bytes and the sizes halfway between them, 48, 96, and
+   so on up to 3 kB, so that no more than a third of a block is
+   wasted beyond the smallest classes.  The descriptor keeps a
+   list of free blocks.  If the free list is nonempty, one of its
+   blocks is used to satisfy the request.
 
    Otherwise, a new page of memory, called an "arena", is
    obtained from the page allocator (if none is available,
@@ -26,13 +30,26 @@
    When we free a block, we add it to its descriptor's free list.
    But if the arena that the block was in now has no in-use
    blocks, we remove all of the arena's blocks from the free list
-   and give the arena back to the page allocator.
-
-   We can't handle blocks bigger than 2 kB using this scheme,
+   and give the arena back to the page allocator, unless the
+   descriptor has fewer than EMPTY_ARENAS_MAX empty arenas, in
+   which case we keep it so that a block allocated and freed over
+   and over does not get and free a page each time.  The page
+   allocator calls malloc_reclaim() to take back the empty arenas
+   we keep when it runs out of pages.
+
+   We can't handle blocks bigger than 3 kB using this scheme,
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.
+
+   realloc() leaves a block where it is if it is already big
+   enough.  A big block is resized in place by giving back pages
+   at its end or by taking the free pages that follow it, and is
+   only moved if those are not free.
+
+   Objects from slab caches (see slab.c) may also be passed to
+   free(), which tells them apart by their page header. */
 
 /* Descriptor. */
 struct desc {
@@ -40,8 +57,14 @@ struct desc {
 	size_t blocks_per_arena;    /* Number of blocks in an arena. */
 	struct list free_list;      /* List of free blocks. */
 	struct lock lock;           /* Lock. */
+	size_t arena_cnt;           /* Number of arenas. */
+	size_t empty_cnt;           /* Arenas with no blocks in use. */
+	size_t in_use;              /* Blocks in use. */
 };
 
+/* Empty arenas kept per descriptor. */
+#define EMPTY_ARENAS_MAX 2
+
 /* Magic number for detecting arena corruption. */
 #define ARENA_MAGIC 0x9a548eed
 
@@ -57,26 +80,45 @@ struct block {
 	struct list_elem free_elem; /* Free list element. */
 };
 
+/* Block sizes of the descriptors, in increasing order.  There is
+   no 2 kB class: a page holds only one such block, just as it
+   holds one 3 kB block. */
+static const size_t block_sizes[] = {
+	16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 3072,
+};
+
 /* Our set of descriptors. */
-static struct desc descs[10];   /* Descriptors. */
+#define DESC_CNT (sizeof block_sizes / sizeof *block_sizes)
+static struct desc descs[DESC_CNT]; /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Big blocks. */
+static struct lock big_lock;    /* Protects the counts below. */
+static size_t big_cnt;          /* Number of big blocks. */
+static size_t big_pages;        /* Pages in big blocks. */
+
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static bool resize_in_place (void *block, size_t new_size);
+static void release_arena (struct desc *, struct arena *);
+static void count_big (long blocks, long pages);
 
 /* Initializes the malloc() descriptors. */
 void
 malloc_init (void) {
-	size_t block_size;
+	size_t i;
 
-	for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2) {
+	for (i = 0; i < DESC_CNT; i++) {
 		struct desc *d = &descs[desc_cnt++];
-		ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
-		d->block_size = block_size;
-		d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
+		d->block_size = block_sizes[i];
+		d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / d->block_size;
+		ASSERT (d->blocks_per_arena > 0);
 		list_init (&d->free_list);
 		lock_init (&d->lock);
+		d->arena_cnt = d->empty_cnt = d->in_use = 0;
 	}
+	lock_init (&big_lock);
+	palloc_add_reclaim (malloc_reclaim);
 }
 
 /* Obtains and returns a new block of at least SIZE bytes.
@@ -109,6 +151,7 @@ malloc (size_t size) {
 		a->magic = ARENA_MAGIC;
 		a->desc = NULL;
 		a->free_cnt = page_cnt;
+		count_big (1, page_cnt);
 		return a + 1;
 	}
 
@@ -133,12 +176,16 @@ malloc (size_t size) {
 			struct block *b = arena_to_block (a, i);
 			list_push_back (&d->free_list, &b->free_elem);
 		}
+		d->arena_cnt++;
+		d->empty_cnt++;
 	}
 
 	/* Get a block from free list and return it. */
 	b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
 	a = block_to_arena (b);
-	a->free_cnt--;
+	if (a->free_cnt-- == d->blocks_per_arena)
+		d->empty_cnt--;
+	d->in_use++;
 	lock_release (&d->lock);
 	return b;
 }
@@ -167,14 +214,18 @@ calloc (size_t a, size_t b) {
 static size_t
 block_size (void *block) {
 	struct block *b = block;
-	struct arena *a = block_to_arena (b);
-	struct desc *d = a->desc;
+	struct arena *a;
+	struct desc *d;
 
+	if (slab_owns (block))
+		return slab_object_size (block);
+	a = block_to_arena (b);
+	d = a->desc;
 	return d != NULL ? d->block_size : PGSIZE * a->free_cnt - pg_ofs (block);
 }
 
-/* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
-   moving it in the process.
+/* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, moving it
+   only if it cannot be resized in place.
    If successful, returns the new block; on failure, returns a
    null pointer.
    A call with null OLD_BLOCK is equivalent to malloc(NEW_SIZE).
@@ -184,7 +235,9 @@ realloc (void *old_block, size_t new_size) {
 	if (new_size == 0) {
 		free (old_block);
 		return NULL;
-	} else {
+	} else if (old_block != NULL && resize_in_place (old_block, new_size))
+		return old_block;
+	else {
 		void *new_block = malloc (new_size);
 		if (old_block != NULL && new_block != NULL) {
 			size_t old_size = block_size (old_block);
@@ -197,10 +250,12 @@ realloc (void *old_block, size_t new_size) {
 }
 
 /* Frees block P, which must have been previously allocated with
-   malloc(), calloc(), or realloc(). */
+   malloc(), calloc(), or realloc(), or from a slab cache. */
 void
 free (void *p) {
-	if (p != NULL) {
+	if (p != NULL && slab_owns (p))
+		slab_free (p);
+	else if (p != NULL) {
 		struct block *b = p;
 		struct arena *a = block_to_arena (b);
 		struct desc *d = a->desc;
@@ -217,28 +272,138 @@ free (void *p) {
 
 			/* Add block to free list. */
 			list_push_front (&d->free_list, &b->free_elem);
+			d->in_use--;
 
-			/* If the arena is now entirely unused, free it. */
+			/* If the arena is now entirely unused, keep it or free
+			   it. */
 			if (++a->free_cnt >= d->blocks_per_arena) {
-				size_t i;
-
 				ASSERT (a->free_cnt == d->blocks_per_arena);
-				for (i = 0; i < d->blocks_per_arena; i++) {
-					struct block *b = arena_to_block (a, i);
-					list_remove (&b->free_elem);
-				}
-				palloc_free_page (a);
+				if (d->empty_cnt < EMPTY_ARENAS_MAX)
+					d->empty_cnt++;
+				else
+					release_arena (d, a);
 			}
 
 			lock_release (&d->lock);
 		} else {
 			/* It's a big block.  Free its pages. */
+			count_big (-1, -(long) a->free_cnt);
 			palloc_free_multiple (a, a->free_cnt);
 			return;
 		}
 	}
 }
 
+/* Tries to resize BLOCK to NEW_SIZE bytes without moving it.
+   Returns true if successful, false if BLOCK must move. */
+static bool
+resize_in_place (void *block, size_t new_size) {
+	struct arena *a;
+	size_t page_cnt;
+
+	if (slab_owns (block) || block_to_arena (block)->desc != NULL)
+		return new_size <= block_size (block);
+
+	/* A big block: give back or take pages at its end. */
+	a = block_to_arena (block);
+	page_cnt = DIV_ROUND_UP (new_size + sizeof *a, PGSIZE);
+	if (page_cnt < a->free_cnt)
+		palloc_free_multiple ((uint8_t *) a + PGSIZE * page_cnt,
+				a->free_cnt - page_cnt);
+	else if (!palloc_extend (a, a->free_cnt, page_cnt))
+		return false;
+	count_big (0, (long) page_cnt - (long) a->free_cnt);
+	a->free_cnt = page_cnt;
+	return true;
+}
+
+/* Gives the empty arenas that descriptors keep back to the page
+   allocator, skipping descriptors that are busy.  Returns the
+   number of pages freed.  Called by the page allocator when it
+   runs out of pages. */
+size_t
+malloc_reclaim (void) {
+	size_t freed = 0;
+	struct desc *d;
+
+	for (d = descs; d < descs + desc_cnt; d++) {
+		struct list_elem *e;
+
+		if (lock_held_by_current_thread (&d->lock)
+				|| !lock_try_acquire (&d->lock))
+			continue;
+
+		/* Releasing an arena removes blocks from the free list,
+		   so start over after each one. */
+		e = list_begin (&d->free_list);
+		while (d->empty_cnt > 0 && e != list_end (&d->free_list)) {
+			struct block *b = list_entry (e, struct block, free_elem);
+			struct arena *a = block_to_arena (b);
+
+			if (a->free_cnt == d->blocks_per_arena) {
+				d->empty_cnt--;
+				release_arena (d, a);
+				freed++;
+				e = list_begin (&d->free_list);
+			} else
+				e = list_next (e);
+		}
+		lock_release (&d->lock);
+	}
+	return freed;
+}
+
+/* Prints, for each size class in use and for big blocks, the
+   memory held and how much of it is in use. */
+void
+malloc_print_stats (void) {
+	struct desc *d;
+
+	printf ("Malloc arenas:\n");
+	for (d = descs; d < descs + desc_cnt; d++) {
+		size_t total;
+
+		lock_acquire (&d->lock);
+		total = d->arena_cnt * d->blocks_per_arena;
+		if (d->arena_cnt > 0)
+			printf ("  %4zu bytes: %zu arenas (%zu empty), %zu of %zu blocks "
+					"in use (%zu%%)\n", d->block_size, d->arena_cnt,
+					d->empty_cnt, d->in_use, total, d->in_use * 100 / total);
+		lock_release (&d->lock);
+	}
+
+	lock_acquire (&big_lock);
+	printf ("  big blocks: %zu in %zu pages\n", big_cnt, big_pages);
+	lock_release (&big_lock);
+}
+
+/* Removes the blocks of A, an empty arena of D, from D's free
+   list and frees A.  D's lock must be held. */
+static void
+release_arena (struct desc *d, struct arena *a) {
+	size_t i;
+
+	ASSERT (lock_held_by_current_thread (&d->lock));
+	ASSERT (a->free_cnt == d->blocks_per_arena);
+
+	for (i = 0; i < d->blocks_per_arena; i++) {
+		struct block *b = arena_to_block (a, i);
+		list_remove (&b->free_elem);
+	}
+	palloc_free_page (a);
+	d->arena_cnt--;
+}
+
+/* Adds BLOCKS and PAGES, which may be negative, to the big block
+   counts. */
+static void
+count_big (long blocks, long pages) {
+	lock_acquire (&big_lock);
+	big_cnt += blocks;
+	big_pages += pages;
+	lock_release (&big_lock);
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b) {
@@ -1,19 +1,76 @@
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
+#include "threads/pcid.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
 #include "intrinsic.h"
 
+/* Returns true if PML4 is the active page map.  The low bits of
+ * CR3 hold the PCID, if any. */
+static bool
+is_active (uint64_t *pml4) {
+	return (rcr3 () & ~(uint64_t) PGMASK) == vtop (pml4);
+}
+
+/* Invalidates the TLB entry for VA in PML4, whether PML4 is
+ * active or, with PCIDs, has entries tagged with its PCID. */
+static void
+tlb_invalidate (uint64_t *pml4, uint64_t va) {
+	if (is_active (pml4))
+		invlpg (va);
+	else
+		pcid_invalidate (pml4, va);
+}
+
+/* Statistics for user 2 MiB pages. */
+static long long large_mapped_cnt;  /* Mapped by pml4_set_large_page(). */
+static long long large_split_cnt;   /* Split into 4 kB pages. */
+static long long large_active_cnt;  /* Currently mapped. */
+
+/* Replaces ENTRY, which maps a large page of SIZE bytes, by a
+ * pointer to a new page table that maps the same memory, with the
+ * same permissions, in 512 pages of the next smaller size.  Since
+ * no translation changes, no TLB flush is needed.  Returns false
+ * if memory allocation fails. */
+static bool
+split_large (uint64_t *entry, size_t size) {
+	uint64_t *table = palloc_get_page (0);
+	uint64_t pa = PTE_ADDR (*entry) & ~(size - 1);
+	uint64_t flags = *entry & PTE_FLAGS & ~PTE_PS;
+	size_t sub = size / 512;
+	unsigned i;
+
+	if (table == NULL)
+		return false;
+	if (sub > PGSIZE)
+		flags |= PTE_PS;
+	for (i = 0; i < 512; i++)
+		table[i] = (pa + i * sub) | flags;
+	*entry = vtop (table) | PTE_U | PTE_W | PTE_P;
+	if (flags & PTE_U) {
+		large_split_cnt++;
+		large_active_cnt--;
+	}
+	return true;
+}
+
 static uint64_t *
 pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
 	int idx = PDX (va);
 	if (pdp) {
 		uint64_t *pte = (uint64_t *) pdp[idx];
-		if (!((uint64_t) pte & PTE_P)) {
+		if (((uint64_t) pte & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS)) {
+			/* A 2 MiB page.  Split it to reach a PTE. */
+			if (!create)
+				return &pdp[idx];
+			if (!split_large (&pdp[idx], LARGE_PAGE_SIZE))
+				return NULL;
+		} else if (!((uint64_t) pte & PTE_P)) {
 			if (create) {
 				uint64_t *new_page = palloc_get_page (PAL_ZERO);
 				if (new_page)
@@ -35,7 +92,13 @@ pdpe_walk (uint64_t *pdpe, const uint64_t va, int create) {
 	int allocated = 0;
 	if (pdpe) {
 		uint64_t *pde = (uint64_t *) pdpe[idx];
-		if (!((uint64_t) pde & PTE_P)) {
+		if (((uint64_t) pde & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS)) {
+			/* A 1 GiB page.  Split it to reach a PTE. */
+			if (!create)
+				return &pdpe[idx];
+			if (!split_large (&pdpe[idx], HUGE_PAGE_SIZE))
+				return NULL;
+		} else if (!((uint64_t) pde & PTE_P)) {
 			if (create) {
 				uint64_t *new_page = palloc_get_page (PAL_ZERO);
 				if (new_page) {
@@ -60,7 +123,10 @@ pdpe_walk (uint64_t *pdpe, const uint64_t va, int create) {
  * If PML4E does not have a page table for VADDR, behavior depends
  * on CREATE.  If CREATE is true, then a new page table is
  * created and a pointer into it is returned.  Otherwise, a null
- * pointer is returned. */
+ * pointer is returned.
+ * If VADDR is mapped by a 2 MiB or 1 GiB page, then with CREATE
+ * the large page is split into 4 kB pages, and without it the
+ * PDE or PDPE that maps the large page is returned. */
 uint64_t *
 pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
 	uint64_t *pte = NULL;
@@ -88,6 +154,62 @@ pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
 	return pte;
 }
 
+/* Returns the entry of PML4 that maps the page of SIZE bytes at
+ * VA, a PTE for PGSIZE, a PDE for LARGE_PAGE_SIZE, or a PDPE for
+ * HUGE_PAGE_SIZE, creating page tables down to that level as
+ * needed.  The caller sets PTE_PS in a large page's entry.
+ * Returns a null pointer if memory allocation fails or if a
+ * larger page already maps VA. */
+uint64_t *
+pml4e_walk_size (uint64_t *pml4, const uint64_t va, size_t size) {
+	uint64_t *table = pml4;
+	unsigned shift = PML4SHIFT;
+
+	ASSERT (size == PGSIZE || size == LARGE_PAGE_SIZE
+			|| size == HUGE_PAGE_SIZE);
+	ASSERT (va % size == 0);
+
+	for (;;) {
+		uint64_t *entry = &table[(va >> shift) & 0x1FF];
+
+		if ((1UL << shift) == size)
+			return entry;
+		if (!(*entry & PTE_P)) {
+			uint64_t *new_page = palloc_get_page (PAL_ZERO);
+			if (new_page == NULL)
+				return NULL;
+			*entry = vtop (new_page) | PTE_U | PTE_W | PTE_P;
+		} else if (*entry & PTE_PS)
+			return NULL;
+		table = ptov (PTE_ADDR (*entry));
+		shift -= 9;
+	}
+}
+
+/* Returns the entry of PML4 that maps VA, whatever the size of the
+ * page it maps, and stores that size in *SIZE.  Returns a null
+ * pointer if no page table covers VA. */
+static uint64_t *
+leaf_lookup (uint64_t *pml4, const uint64_t va, size_t *size) {
+	uint64_t *entry = &pml4[PML4 (va)];
+	unsigned shift;
+
+	for (shift = PDPESHIFT; shift >= PTXSHIFT; shift -= 9) {
+		uint64_t *table;
+
+		if (!(*entry & PTE_P))
+			return NULL;
+		table = ptov (PTE_ADDR (*entry));
+		entry = &table[(va >> shift) & 0x1FF];
+		if (shift == PTXSHIFT
+				|| (*entry & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS)) {
+			*size = 1UL << shift;
+			return entry;
+		}
+	}
+	NOT_REACHED ();
+}
+
 /* Creates a new page map level 4 (pml4) has mappings for kernel
  * virtual addresses, but none for user virtual addresses.
  * Returns the new page directory, or a null pointer if memory
@@ -122,7 +244,13 @@ pgdir_for_each (uint64_t *pdp, pte_for_each_func *func, void *aux,
 		unsigned pml4_index, unsigned pdp_index) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
+		if (((uint64_t) pte) & PTE_P && ((uint64_t) pte) & PTE_PS) {
+			void *va = (void *) (((uint64_t) pml4_index << PML4SHIFT) |
+								 ((uint64_t) pdp_index << PDPESHIFT) |
+								 ((uint64_t) i << PDXSHIFT));
+			if (!func (&pdp[i], va, aux))
+				return false;
+		} else if (((uint64_t) pte) & PTE_P)
 			if (!pt_for_each ((uint64_t *) PTE_ADDR (pte), func, aux,
 					pml4_index, pdp_index, i))
 				return false;
@@ -135,7 +263,12 @@ pdp_for_each (uint64_t *pdp,
 		pte_for_each_func *func, void *aux, unsigned pml4_index) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pde = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pde) & PTE_P)
+		if (((uint64_t) pde) & PTE_P && ((uint64_t) pde) & PTE_PS) {
+			void *va = (void *) (((uint64_t) pml4_index << PML4SHIFT) |
+								 ((uint64_t) i << PDPESHIFT));
+			if (!func (&pdp[i], va, aux))
+				return false;
+		} else if (((uint64_t) pde) & PTE_P)
 			if (!pgdir_for_each ((uint64_t *) PTE_ADDR (pde), func,
 					 aux, pml4_index, i))
 				return false;
@@ -143,7 +276,8 @@ pdp_for_each (uint64_t *pdp,
 	return true;
 }
 
-/* Apply FUNC to each available pte entries including kernel's. */
+/* Apply FUNC to each available pte entries including kernel's.
+ * For a large page, FUNC gets the PDE or PDPE that maps it. */
 bool
 pml4_for_each (uint64_t *pml4, pte_for_each_func *func, void *aux) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
@@ -169,7 +303,11 @@ static void
 pgdir_destroy (uint64_t *pdp) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
+		if (((uint64_t) pte) & PTE_P && ((uint64_t) pte) & PTE_PS) {
+			palloc_free_multiple ((void *) PTE_ADDR (pte),
+					LARGE_PAGE_SIZE / PGSIZE);
+			large_active_cnt--;
+		} else if (((uint64_t) pte) & PTE_P)
 			pt_destroy (PTE_ADDR (pte));
 	}
 	palloc_free_page ((void *) pdp);
@@ -179,7 +317,9 @@ static void
 pdpe_destroy (uint64_t *pdpe) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pde = ptov((uint64_t *) pdpe[i]);
-		if (((uint64_t) pde) & PTE_P)
+		/* 1 GiB pages map only the kernel's memory, which is not
+		 * ours to free. */
+		if (((uint64_t) pde) & PTE_P && !(((uint64_t) pde) & PTE_PS))
 			pgdir_destroy ((void *) PTE_ADDR (pde));
 	}
 	palloc_free_page ((void *) pdpe);
@@ -196,14 +336,16 @@ pml4_destroy (uint64_t *pml4) {
 	uint64_t *pdpe = ptov ((uint64_t *) pml4[0]);
 	if (((uint64_t) pdpe) & PTE_P)
 		pdpe_destroy ((void *) PTE_ADDR (pdpe));
+	pcid_release (pml4);
 	palloc_free_page ((void *) pml4);
 }
 
 /* Loads page directory PD into the CPU's page directory base
- * register. */
+ * register.  With PCIDs, the TLB entries of PD's last run are
+ * kept instead of being flushed. */
 void
 pml4_activate (uint64_t *pml4) {
-	lcr3 (vtop (pml4 ? pml4 : base_pml4));
+	lcr3 (pcid_cr3 (pml4 ? pml4 : base_pml4));
 }
 
 /* Looks up the physical address that corresponds to user virtual
@@ -214,10 +356,12 @@ void *
 pml4_get_page (uint64_t *pml4, const void *uaddr) {
 	ASSERT (is_user_vaddr (uaddr));
 
-	uint64_t *pte = pml4e_walk (pml4, (uint64_t) uaddr, 0);
+	size_t size;
+	uint64_t *pte = leaf_lookup (pml4, (uint64_t) uaddr, &size);
 
 	if (pte && (*pte & PTE_P))
-		return ptov (PTE_ADDR (*pte)) + pg_ofs (uaddr);
+		return ptov (PTE_ADDR (*pte) & ~(size - 1))
+			+ ((uint64_t) uaddr & (size - 1));
 	return NULL;
 }
 
@@ -243,10 +387,70 @@ pml4_set_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
 	return pte != NULL;
 }
 
+/* Maps the 2 MiB of user virtual memory at UPAGE in PML4 to the
+ * physical memory at kernel virtual address KPAGE with a single
+ * large page, as read/write if RW is true, otherwise read-only.
+ * Both must be aligned to LARGE_PAGE_SIZE in physical memory; a
+ * block of 512 pages from palloc_get_multiple() always is.
+ * Nothing in the 2 MiB may be mapped yet.  Returns true if
+ * successful, false if memory allocation failed or if part of the
+ * range already has a page table.
+ * The large page is split into 4 kB pages when any function below
+ * changes the mapping of only part of it, or by
+ * pml4_split_page(). */
+bool
+pml4_set_large_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
+	uint64_t *pde;
+
+	ASSERT ((uint64_t) upage % LARGE_PAGE_SIZE == 0);
+	ASSERT (vtop (kpage) % LARGE_PAGE_SIZE == 0);
+	ASSERT (is_user_vaddr (upage));
+	ASSERT (is_user_vaddr ((uint8_t *) upage + LARGE_PAGE_SIZE - 1));
+	ASSERT (pml4 != base_pml4);
+
+	pde = pml4e_walk_size (pml4, (uint64_t) upage, LARGE_PAGE_SIZE);
+	if (pde == NULL || (*pde & PTE_P))
+		return false;
+	*pde = vtop (kpage) | PTE_P | PTE_PS | (rw ? PTE_W : 0) | PTE_U;
+	large_mapped_cnt++;
+	large_active_cnt++;
+	return true;
+}
+
+/* If user virtual address UADDR is mapped by a large page in PML4,
+ * splits it into 4 kB pages with the same permissions, so that
+ * they can be changed, unmapped or swapped out one by one.
+ * Returns false only if UADDR is in a large page and there is no
+ * memory to split it. */
+bool
+pml4_split_page (uint64_t *pml4, const void *uaddr) {
+	uint64_t *pte;
+
+	ASSERT (is_user_vaddr (uaddr));
+
+	pte = pml4e_walk (pml4, (uint64_t) uaddr, false);
+	if (pte == NULL || (*pte & (PTE_P | PTE_PS)) != (PTE_P | PTE_PS))
+		return true;
+	if (pml4e_walk (pml4, (uint64_t) uaddr, true) == NULL)
+		return false;
+	tlb_invalidate (pml4, (uint64_t) uaddr);
+	return true;
+}
+
+/* Prints statistics about user large pages. */
+void
+pml4_print_stats (void) {
+	printf ("Paging: %lld 2 MiB user pages mapped, %lld split, "
+			"%lld MiB mapped now\n", large_mapped_cnt, large_split_cnt,
+			large_active_cnt * (long long) (LARGE_PAGE_SIZE >> 20));
+}
+
 /* Marks user virtual page UPAGE "not present" in page
  * directory PD.  Later accesses to the page will fault.  Other
  * bits in the page table entry are preserved.
- * UPAGE need not be mapped. */
+ * UPAGE need not be mapped.  If it is part of a large page, the
+ * large page is split first, or unmapped as a whole if there is
+ * no memory to split it. */
 void
 pml4_clear_page (uint64_t *pml4, void *upage) {
 	uint64_t *pte;
@@ -254,11 +458,13 @@ pml4_clear_page (uint64_t *pml4, void *upage) {
 	ASSERT (is_user_vaddr (upage));
 
 	pte = pml4e_walk (pml4, (uint64_t) upage, false);
+	if (pte != NULL && (*pte & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS)
+			&& pml4_split_page (pml4, upage))
+		pte = pml4e_walk (pml4, (uint64_t) upage, false);
 
 	if (pte != NULL && (*pte & PTE_P) != 0) {
 		*pte &= ~PTE_P;
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) upage);
+		tlb_invalidate (pml4, (uint64_t) upage);
 	}
 }
 
@@ -283,8 +489,7 @@ pml4_set_dirty (uint64_t *pml4, const void *vpage, bool dirty) {
 		else
 			*pte &= ~(uint32_t) PTE_D;
 
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) vpage);
+		tlb_invalidate (pml4, (uint64_t) vpage);
 	}
 }
 
@@ -309,7 +514,6 @@ pml4_set_accessed (uint64_t *pml4, const void *vpage, bool accessed) {
 		else
 			*pte &= ~(uint32_t) PTE_A;
 
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) vpage);
+		tlb_invalidate (pml4, (uint64_t) vpage);
 	}
 }
@@ -2,12 +2,14 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -24,24 +26,97 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Each pool is managed as a binary buddy system.  Free memory is
+   kept as blocks of 2**ORDER pages, for ORDER up to
+   PALLOC_MAX_ORDER, each aligned to its own size in physical
+   memory, on one free list per order.  A request for N pages
+   takes the smallest free block of at least N pages, splitting
+   larger blocks in half as needed, and gives the unused tail
+   back; freeing a block merges it with its "buddy", the other
+   half of the next larger block, for as long as the buddy is
+   free too.  Both take O(log n) steps, and free memory stays in
+   the largest blocks possible.
+
+   The list element of a free block is kept in its first page.
+   order_map records, for each page, the order of the free block
+   that starts there, or NOT_FREE.  used_map is not needed by the
+   buddy system, but is kept up to date to catch double frees and
+   for debugging.
+
+   Each pool also keeps a list of free pages that are already
+   zeroed, which single-page PAL_ZERO requests take first.  The
+   idle thread fills it up to ZEROED_WATERMARK pages through
+   palloc_prezero(), as long as the pool has more than
+   ZEROED_RESERVE pages free.  Zeroed pages count as allocated in
+   the buddy system; an allocation that cannot be satisfied gives
+   them back first.
+
+   Allocators that keep free pages cached, such as malloc() and
+   the slab allocator, register a function with
+   palloc_add_reclaim().  When a kernel pool request cannot be
+   satisfied, we call those functions to give their pages back
+   and try once more. */
+
+/* Largest block order: blocks of up to 2**PALLOC_MAX_ORDER pages. */
+#define PALLOC_MAX_ORDER 10
+
+/* order_map value for a page that does not start a free block. */
+#define NOT_FREE 0xff
+
+/* Pre-zeroed pages kept per pool, and free pages below which
+   the idle thread stops zeroing. */
+#define ZEROED_WATERMARK 32
+#define ZEROED_RESERVE (4 * ZEROED_WATERMARK)
 
 /* A memory pool. */
 struct pool {
 	struct lock lock;               /* Mutual exclusion. */
 	struct bitmap *used_map;        /* Bitmap of free pages. */
 	uint8_t *base;                  /* Base of pool. */
+	uint8_t *order_map;             /* Free block order per page. */
+	struct list free_list[PALLOC_MAX_ORDER + 1]; /* Free blocks. */
+	size_t free_cnt[PALLOC_MAX_ORDER + 1];      /* Blocks per list. */
+	size_t free_pages;              /* Pages in free blocks. */
+
+	/* Pre-zeroed pages.  Protected by disabling interrupts, not
+	   by LOCK, so that the idle thread never waits for them. */
+	struct list zeroed;             /* Zeroed pages. */
+	size_t zeroed_cnt;              /* Number of pages in ZEROED. */
+	size_t zeroed_hits;             /* PAL_ZERO pages taken from ZEROED. */
+	size_t zeroed_misses;           /* PAL_ZERO pages zeroed inline. */
+};
+
+/* A free block or zeroed page, stored in its first page. */
+struct free_block {
+	struct list_elem elem;          /* Element in free_list or zeroed. */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
 static struct pool kernel_pool, user_pool;
 
+/* Functions to call when out of pages. */
+#define RECLAIM_MAX 4
+static palloc_reclaim_func *reclaim_funcs[RECLAIM_MAX];
+static size_t reclaim_cnt;
+
 /* Maximum number of pages to put in user pool. */
 size_t user_page_limit = SIZE_MAX;
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end);
 
 static bool page_from_pool (const struct pool *, void *page);
+static size_t pool_size (const struct pool *);
+static bool alloc_block (struct pool *, int order, size_t *idx);
+static void free_block (struct pool *, size_t idx, int order);
+static void free_range (struct pool *, size_t idx, size_t page_cnt);
+static void claim_page (struct pool *, size_t idx);
+static void *get_block (struct pool *, size_t page_cnt, int order,
+		bool zero);
+static bool reclaim (void);
+static void *take_zeroed (struct pool *, bool zero);
+static bool drain_zeroed (struct pool *);
 
 /* multiboot info */
 struct multiboot_info {
@@ -219,16 +294,16 @@ split:
 			else
 				NOT_REACHED ();
 
-			pool_end = pool->base + bitmap_size (pool->used_map) * PGSIZE;
+			pool_end = pool->base + pool_size (pool) * PGSIZE;
 			page_idx = pg_no (start) - pg_no (pool->base);
 			if ((uint64_t) pool_end < end) {
 				page_cnt = ((uint64_t) pool_end - start) / PGSIZE;
-				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				free_range (pool, page_idx, page_cnt);
 				start = (uint64_t) pool_end;
 				goto split;
 			} else {
 				page_cnt = ((uint64_t) end - start) / PGSIZE;
-				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				free_range (pool, page_idx, page_cnt);
 			}
 		}
 	}
@@ -258,20 +333,33 @@ palloc_init (void) {
    otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
    then the pages are filled with zeros.  If too few pages are
    available, returns a null pointer, unless PAL_ASSERT is set in
-   FLAGS, in which case the kernel panics. */
+   FLAGS, in which case the kernel panics.
+
+   The pages start at a physical address aligned to the smallest
+   power of two pages that is at least PAGE_CNT.  At most
+   2**PALLOC_MAX_ORDER pages can be obtained at once. */
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
 	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	void *pages = NULL;
+	int order = 0;
 
-	lock_acquire (&pool->lock);
-	size_t page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-	lock_release (&pool->lock);
-	void *pages;
+	while (order <= PALLOC_MAX_ORDER && ((size_t) 1 << order) < page_cnt)
+		order++;
 
-	if (page_idx != BITMAP_ERROR)
-		pages = pool->base + PGSIZE * page_idx;
-	else
-		pages = NULL;
+	if (page_cnt == 1 && (flags & PAL_ZERO)) {
+		pages = take_zeroed (pool, true);
+		if (pages != NULL)
+			return pages;
+	}
+
+	if (page_cnt > 0 && order <= PALLOC_MAX_ORDER) {
+		bool zero = (flags & PAL_ZERO) != 0;
+
+		pages = get_block (pool, page_cnt, order, zero);
+		if (pages == NULL && pool == &kernel_pool && reclaim ())
+			pages = get_block (pool, page_cnt, order, zero);
+	}
 
 	if (pages) {
 		if (flags & PAL_ZERO)
@@ -318,8 +406,10 @@ palloc_free_multiple (void *pages, size_t page_cnt) {
 #ifndef NDEBUG
 	memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
+	lock_acquire (&pool->lock);
 	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	free_range (pool, page_idx, page_cnt);
+	lock_release (&pool->lock);
 }
 
 /* Frees the page at PAGE. */
@@ -328,23 +418,400 @@ palloc_free_page (void *page) {
 	palloc_free_multiple (page, 1);
 }
 
+/* Registers FUNC to be called to free cached pages when a
+   request for pages cannot be satisfied.  FUNC must not wait for
+   a lock that a thread allocating pages may hold. */
+void
+palloc_add_reclaim (palloc_reclaim_func *func) {
+	ASSERT (reclaim_cnt < RECLAIM_MAX);
+	reclaim_funcs[reclaim_cnt++] = func;
+}
+
+/* Grows the block of OLD_CNT pages at PAGES, obtained from
+   palloc_get_multiple(), to NEW_CNT pages by taking the pages
+   that follow it.  Returns true if successful, false if any of
+   those pages is in use or outside the block's pool, in which
+   case nothing changes.  The new pages are not zeroed. */
+bool
+palloc_extend (void *pages, size_t old_cnt, size_t new_cnt) {
+	struct pool *pool;
+	size_t idx, i;
+	bool success = false;
+
+	ASSERT (pg_ofs (pages) == 0);
+	ASSERT (old_cnt > 0);
+	if (new_cnt <= old_cnt)
+		return new_cnt == old_cnt;
+
+	if (page_from_pool (&kernel_pool, pages))
+		pool = &kernel_pool;
+	else if (page_from_pool (&user_pool, pages))
+		pool = &user_pool;
+	else
+		NOT_REACHED ();
+
+	idx = pg_no (pages) - pg_no (pool->base) + old_cnt;
+	lock_acquire (&pool->lock);
+	ASSERT (bitmap_all (pool->used_map, idx - old_cnt, old_cnt));
+	if (idx + (new_cnt - old_cnt) <= pool_size (pool)
+			&& bitmap_none (pool->used_map, idx, new_cnt - old_cnt)) {
+		for (i = idx; i < idx + (new_cnt - old_cnt); i++)
+			claim_page (pool, i);
+		bitmap_set_multiple (pool->used_map, idx, new_cnt - old_cnt, true);
+		success = true;
+	}
+	lock_release (&pool->lock);
+	return success;
+}
+
+/* Takes PAGE_CNT pages, from a block of 2**ORDER pages, from
+   POOL and returns them, or a null pointer if not enough pages
+   are free.  ZERO says whether the caller will zero them. */
+static void *
+get_block (struct pool *pool, size_t page_cnt, int order, bool zero) {
+	void *pages = NULL;
+	size_t page_idx;
+	bool found;
+
+	lock_acquire (&pool->lock);
+	found = alloc_block (pool, order, &page_idx);
+	if (!found && order > 0 && drain_zeroed (pool))
+		found = alloc_block (pool, order, &page_idx);
+	if (found) {
+		/* Give back the part of the block we do not need. */
+		free_range (pool, page_idx + page_cnt,
+				((size_t) 1 << order) - page_cnt);
+		bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+		pages = pool->base + PGSIZE * page_idx;
+		if (zero && page_cnt == 1)
+			pool->zeroed_misses++;
+	}
+	lock_release (&pool->lock);
+
+	/* The last free pages may be zeroed ones. */
+	if (pages == NULL && page_cnt == 1)
+		pages = take_zeroed (pool, zero);
+	return pages;
+}
+
+/* Calls the registered reclaim functions.  Returns true if any
+   of them freed pages. */
+static bool
+reclaim (void) {
+	size_t freed = 0;
+	size_t i;
+
+	for (i = 0; i < reclaim_cnt; i++)
+		freed += reclaim_funcs[i] ();
+	return freed > 0;
+}
+
 /* Initializes pool P as starting at START and ending at END */
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
+  /* We'll put the pool's used_map and order_map at *BM_BASE.
+     Calculate the space needed for them and advance *BM_BASE
+     past it. */
 	uint64_t pgcnt = (end - start) / PGSIZE;
 	size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (pgcnt), PGSIZE) * PGSIZE;
+	size_t om_pages = DIV_ROUND_UP (pgcnt, PGSIZE) * PGSIZE;
+	int order;
 
 	lock_init(&p->lock);
 	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_pages);
 	p->base = (void *) start;
+	p->order_map = (uint8_t *) *bm_base + bm_pages;
+	for (order = 0; order <= PALLOC_MAX_ORDER; order++) {
+		list_init (&p->free_list[order]);
+		p->free_cnt[order] = 0;
+	}
 
 	// Mark all to unusable.
 	bitmap_set_all(p->used_map, true);
+	memset (p->order_map, NOT_FREE, pgcnt);
+	p->free_pages = 0;
+	list_init (&p->zeroed);
+	p->zeroed_cnt = p->zeroed_hits = p->zeroed_misses = 0;
+
+	*bm_base += bm_pages + om_pages;
+}
+
+/* Returns the number of pages in POOL. */
+static size_t
+pool_size (const struct pool *pool) {
+	return bitmap_size (pool->used_map);
+}
+
+/* Returns the free block that starts at page IDX of POOL. */
+static struct free_block *
+block_at (const struct pool *pool, size_t idx) {
+	return (struct free_block *) (pool->base + PGSIZE * idx);
+}
+
+/* Puts the block of 2**ORDER pages at page IDX of POOL on its
+   free list, as is, without merging it with its buddy. */
+static void
+push_block (struct pool *pool, size_t idx, int order) {
+	list_push_front (&pool->free_list[order], &block_at (pool, idx)->elem);
+	pool->free_cnt[order]++;
+	pool->free_pages += (size_t) 1 << order;
+	pool->order_map[idx] = order;
+}
+
+/* Takes the free block at page IDX of POOL, of order ORDER, off
+   its free list. */
+static void
+pull_block (struct pool *pool, size_t idx, int order) {
+	ASSERT (pool->order_map[idx] == order);
+
+	list_remove (&block_at (pool, idx)->elem);
+	pool->free_cnt[order]--;
+	pool->free_pages -= (size_t) 1 << order;
+	pool->order_map[idx] = NOT_FREE;
+}
+
+/* Allocates a block of 2**ORDER pages from POOL, splitting a
+   larger free block if there is none of that order, and stores
+   the index of its first page into *IDX.  Returns false if no
+   large enough block is free.  POOL's lock must be held. */
+static bool
+alloc_block (struct pool *pool, int order, size_t *idx) {
+	int k;
+
+	ASSERT (lock_held_by_current_thread (&pool->lock));
+
+	for (k = order; k <= PALLOC_MAX_ORDER; k++)
+		if (!list_empty (&pool->free_list[k]))
+			break;
+	if (k > PALLOC_MAX_ORDER)
+		return false;
+
+	*idx = pg_no (list_front (&pool->free_list[k])) - pg_no (pool->base);
+	pull_block (pool, *idx, k);
+
+	/* Split, keeping the lower half and freeing the upper. */
+	while (k > order) {
+		k--;
+		push_block (pool, *idx + ((size_t) 1 << k), k);
+	}
+	return true;
+}
+
+/* Frees the block of 2**ORDER pages at page IDX of POOL, merging
+   it with its buddy for as long as the buddy is free.  POOL's
+   lock must be held. */
+static void
+free_block (struct pool *pool, size_t idx, int order) {
+	size_t base_pfn = pg_no (pool->base);
+
+	while (order < PALLOC_MAX_ORDER) {
+		size_t buddy = ((base_pfn + idx) ^ ((size_t) 1 << order)) - base_pfn;
+
+		/* A buddy outside the pool wraps around to a huge index. */
+		if (buddy >= pool_size (pool) || pool->order_map[buddy] != order)
+			break;
+		pull_block (pool, buddy, order);
+		if (buddy < idx)
+			idx = buddy;
+		order++;
+	}
+	push_block (pool, idx, order);
+}
+
+/* Frees the PAGE_CNT pages starting at page IDX of POOL, as the
+   largest naturally aligned blocks that they can be divided
+   into.  POOL's lock must be held, except during boot. */
+static void
+free_range (struct pool *pool, size_t idx, size_t page_cnt) {
+	size_t base_pfn = pg_no (pool->base);
+
+	bitmap_set_multiple (pool->used_map, idx, page_cnt, false);
+	while (page_cnt > 0) {
+		int order = 0;
+
+		while (order < PALLOC_MAX_ORDER
+				&& ((base_pfn + idx) & ((size_t) 1 << order)) == 0
+				&& ((size_t) 2 << order) <= page_cnt)
+			order++;
+		free_block (pool, idx, order);
+		idx += (size_t) 1 << order;
+		page_cnt -= (size_t) 1 << order;
+	}
+}
+
+/* Takes free page IDX of POOL out of the free block that holds
+   it, giving the rest of the block back as smaller blocks.
+   POOL's lock must be held. */
+static void
+claim_page (struct pool *pool, size_t idx) {
+	size_t base_pfn = pg_no (pool->base);
+	size_t start, size;
+	int order;
+
+	ASSERT (lock_held_by_current_thread (&pool->lock));
+
+	for (order = 0; order <= PALLOC_MAX_ORDER; order++) {
+		start = ((base_pfn + idx) & ~(((size_t) 1 << order) - 1)) - base_pfn;
+		if (start < pool_size (pool) && pool->order_map[start] == order)
+			break;
+	}
+	ASSERT (order <= PALLOC_MAX_ORDER);
+
+	/* Split the block in halves, keeping the half that holds IDX,
+	   until only IDX is left. */
+	pull_block (pool, start, order);
+	while (order > 0) {
+		order--;
+		size = (size_t) 1 << order;
+		if (idx < start + size)
+			push_block (pool, start + size, order);
+		else {
+			push_block (pool, start, order);
+			start += size;
+		}
+	}
+}
 
-	*bm_base += bm_pages;
+/* Takes a page off POOL's list of zeroed pages and returns it,
+   or returns a null pointer if the list is empty.  ZERO says
+   whether the caller asked for PAL_ZERO, which makes this a hit
+   in the statistics. */
+static void *
+take_zeroed (struct pool *pool, bool zero) {
+	struct free_block *b = NULL;
+	enum intr_level old_level;
+
+	old_level = intr_disable ();
+	if (!list_empty (&pool->zeroed)) {
+		b = list_entry (list_pop_front (&pool->zeroed), struct free_block, elem);
+		pool->zeroed_cnt--;
+		if (zero)
+			pool->zeroed_hits++;
+	}
+	intr_set_level (old_level);
+
+	/* Clear the list element we kept in the page. */
+	if (b != NULL)
+		memset (b, 0, sizeof *b);
+	return b;
+}
+
+/* Gives all of POOL's zeroed pages back to the buddy system.
+   Returns true if there were any.  POOL's lock must be held. */
+static bool
+drain_zeroed (struct pool *pool) {
+	bool drained = false;
+
+	ASSERT (lock_held_by_current_thread (&pool->lock));
+
+	for (;;) {
+		struct free_block *b = NULL;
+		enum intr_level old_level;
+
+		old_level = intr_disable ();
+		if (!list_empty (&pool->zeroed)) {
+			b = list_entry (list_pop_front (&pool->zeroed), struct free_block,
+					elem);
+			pool->zeroed_cnt--;
+		}
+		intr_set_level (old_level);
+
+		if (b == NULL)
+			return drained;
+		free_range (pool, pg_no (b) - pg_no (pool->base), 1);
+		drained = true;
+	}
+}
+
+/* Zeroes one free page into the zeroed list of a pool that is
+   below ZEROED_WATERMARK.  Returns true if it did, false if
+   there is nothing to do or it could not be done without
+   waiting.
+
+   Called by the idle thread, which must never block, and which
+   must never hold a lock that another thread could wait for: a
+   thread that preempted idle would then block on the lock and
+   donate its priority to idle, which is not on the ready list.
+   So the pool lock is only tried, and only with interrupts off,
+   for just as long as it takes to take the page.  Nothing can
+   run in the meantime, so nobody ever waits for it.  The
+   zeroing itself is done outside, with interrupts on. */
+bool
+palloc_prezero (void) {
+	struct pool *pools[] = { &kernel_pool, &user_pool };
+	size_t i;
+
+	for (i = 0; i < sizeof pools / sizeof *pools; i++) {
+		struct pool *pool = pools[i];
+		struct free_block *b;
+		enum intr_level old_level;
+		size_t page_idx;
+		bool found;
+
+		old_level = intr_disable ();
+		found = (pool->zeroed_cnt < ZEROED_WATERMARK
+				&& pool->free_pages > ZEROED_RESERVE
+				&& lock_try_acquire (&pool->lock));
+		if (found) {
+			found = alloc_block (pool, 0, &page_idx);
+			if (found)
+				bitmap_mark (pool->used_map, page_idx);
+			lock_release (&pool->lock);
+		}
+		intr_set_level (old_level);
+		if (!found)
+			continue;
+
+		b = (struct free_block *) (pool->base + PGSIZE * page_idx);
+		memset (b, 0, PGSIZE);
+
+		old_level = intr_disable ();
+		list_push_back (&pool->zeroed, &b->elem);
+		pool->zeroed_cnt++;
+		intr_set_level (old_level);
+		return true;
+	}
+	return false;
+}
+
+/* Prints the number of free blocks of each order in POOL. */
+static void
+print_pool_stats (const char *name, const struct pool *pool) {
+	int order;
+
+	printf ("%s pool free blocks by order:", name);
+	for (order = 0; order <= PALLOC_MAX_ORDER; order++)
+		printf (" %zu", pool->free_cnt[order]);
+	printf (" (%zu of %zu pages free)\n", pool->free_pages, pool_size (pool));
+	printf ("%s pool: %zu zeroed pages, %zu PAL_ZERO hits, %zu misses\n",
+			name, pool->zeroed_cnt, pool->zeroed_hits, pool->zeroed_misses);
+}
+
+/* Prints page allocator statistics. */
+void
+palloc_print_stats (void) {
+	print_pool_stats ("Kernel", &kernel_pool);
+	print_pool_stats ("User", &user_pool);
+}
+
+/* Returns the number of pages in the largest block that could be
+   obtained now from the pool selected by FLAGS.  Like a failing
+   allocation, this gives the pool's zeroed pages back first. */
+size_t
+palloc_largest_free (enum palloc_flags flags) {
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	size_t largest = 0;
+	int order;
+
+	lock_acquire (&pool->lock);
+	drain_zeroed (pool);
+	for (order = PALLOC_MAX_ORDER; order >= 0; order--)
+		if (pool->free_cnt[order] > 0) {
+			largest = (size_t) 1 << order;
+			break;
+		}
+	lock_release (&pool->lock);
+	return largest;
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -353,6 +820,6 @@ static bool
 page_from_pool (const struct pool *pool, void *page) {
 	size_t page_no = pg_no (page);
 	size_t start_page = pg_no (pool->base);
-	size_t end_page = start_page + bitmap_size (pool->used_map);
+	size_t end_page = start_page + pool_size (pool);
 	return page_no >= start_page && page_no < end_page;
 }
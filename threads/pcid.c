@@ -0,0 +1,250 @@
+#include "threads/pcid.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+/* Process-context identifiers.
+
+   Without PCIDs, every load of CR3 flushes the TLB, so a switch
+   between processes costs a refill of every translation they use.
+   With CR4.PCIDE set, TLB entries are tagged with the 12-bit PCID
+   in the low bits of CR3, and a CR3 load with bit 63 set keeps
+   them.  Each page map level 4 then gets its own PCID, and a
+   process finds its translations still cached when it runs again.
+
+   base_pml4 uses PCID 0.  Other pml4s get PCIDs 1 through PCID_MAX
+   in order, the first time they are activated; the assignment is
+   kept in a small open-addressing hash table keyed by pml4.  A
+   PCID is never reused until all of them have been handed out.
+   Then the table is emptied, the whole TLB flushed, and a new
+   "generation" of PCIDs begins, so a new PCID never has stale
+   entries.  The same happens when the table gets too full.
+
+   A pml4 that is not active may still have entries in the TLB, so
+   a change to one of its mappings must invalidate them too.  With
+   INVPCID we invalidate the one entry; without it we mark the
+   pml4's PCID stale and flush it when the pml4 is next activated.
+
+   The table is protected by disabling interrupts. */
+
+/* CR4.PCIDE. */
+#define CR4_PCIDE (1 << 17)
+
+/* CR3 bit that keeps the TLB entries of the new PCID. */
+#define CR3_NOFLUSH (1ULL << 63)
+
+/* Highest PCID. */
+#define PCID_MAX 4095
+
+/* Hash table slots, a power of 2, and the number of entries at
+   which a new generation begins. */
+#define PCID_SLOTS 1024
+#define PCID_LOAD_MAX (PCID_SLOTS * 3 / 4)
+
+/* INVPCID types. */
+#define INVPCID_ADDR 0
+#define INVPCID_ALL 2
+
+/* A pml4's PCID. */
+struct pcid_slot {
+	uint64_t *pml4;             /* Owner, or null if slot is empty. */
+	uint16_t pcid;              /* PCID. */
+	bool stale;                 /* TLB may hold stale entries? */
+};
+
+static struct pcid_slot slots[PCID_SLOTS];
+static size_t slot_cnt;         /* Slots in use. */
+static uint16_t next_pcid;      /* Next PCID to hand out. */
+static bool use_pcid;           /* CR4.PCIDE set? */
+static bool use_invpcid;        /* INVPCID available? */
+
+/* Statistics. */
+static long long generation_cnt;   /* Full flushes for a new generation. */
+static long long assign_cnt;       /* PCIDs handed out. */
+static long long noflush_cnt;      /* CR3 loads that kept the TLB. */
+static long long flush_cnt;        /* CR3 loads that flushed a PCID. */
+
+static struct pcid_slot *lookup (uint64_t *pml4);
+static void new_generation (void);
+
+/* Enables PCIDs if the CPU supports them.  Must be called after
+   paging_init(), while base_pml4 is active. */
+void
+pcid_init (void) {
+	uint32_t eax, ebx, ecx, edx;
+
+	cpuid (1, 0, &eax, &ebx, &ecx, &edx);
+	if (!(ecx & (1 << 17)))             /* PCID. */
+		return;
+
+	cpuid (0, 0, &eax, &ebx, &ecx, &edx);
+	if (eax >= 7) {
+		cpuid (7, 0, &eax, &ebx, &ecx, &edx);
+		use_invpcid = (ebx & (1 << 10)) != 0;
+	}
+
+	ASSERT ((rcr3 () & PGMASK) == 0);
+	lcr4 (rcr4 () | CR4_PCIDE);
+	next_pcid = 1;
+	use_pcid = true;
+}
+
+/* Returns true if PCIDs are in use. */
+bool
+pcid_enabled (void) {
+	return use_pcid;
+}
+
+/* Returns the value to load into CR3 to activate PML4, giving
+   PML4 a PCID if it has none. */
+uint64_t
+pcid_cr3 (uint64_t *pml4) {
+	struct pcid_slot *s;
+	enum intr_level old_level;
+	uint64_t cr3;
+
+	if (!use_pcid)
+		return vtop (pml4);
+
+	/* Kernel mappings change only during boot, so PCID 0 never
+	   needs a flush. */
+	if (pml4 == base_pml4) {
+		noflush_cnt++;
+		return vtop (pml4) | CR3_NOFLUSH;
+	}
+
+	old_level = intr_disable ();
+	s = lookup (pml4);
+	if (s->pml4 == NULL) {
+		if (next_pcid > PCID_MAX || slot_cnt >= PCID_LOAD_MAX) {
+			new_generation ();
+			s = lookup (pml4);
+		}
+		s->pml4 = pml4;
+		s->pcid = next_pcid++;
+		s->stale = false;
+		slot_cnt++;
+		assign_cnt++;
+	}
+
+	cr3 = vtop (pml4) | s->pcid;
+	if (s->stale) {
+		s->stale = false;
+		flush_cnt++;
+	} else {
+		cr3 |= CR3_NOFLUSH;
+		noflush_cnt++;
+	}
+	intr_set_level (old_level);
+	return cr3;
+}
+
+/* Invalidates any TLB entry for VA that PML4, which is not the
+   active pml4, left behind. */
+void
+pcid_invalidate (uint64_t *pml4, uint64_t va) {
+	struct pcid_slot *s;
+	enum intr_level old_level;
+
+	if (!use_pcid)
+		return;
+
+	old_level = intr_disable ();
+	s = lookup (pml4);
+	if (s->pml4 != NULL) {
+		if (use_invpcid)
+			invpcid (INVPCID_ADDR, s->pcid, va);
+		else
+			s->stale = true;
+	}
+	intr_set_level (old_level);
+}
+
+/* Forgets the PCID of PML4, which is about to be destroyed, so
+   that a pml4 allocated later at the same address does not
+   inherit it.  Its TLB entries can stay: its PCID is not used
+   again before the next generation flushes them. */
+void
+pcid_release (uint64_t *pml4) {
+	struct pcid_slot *s;
+	enum intr_level old_level;
+	size_t i, j;
+
+	if (!use_pcid)
+		return;
+
+	old_level = intr_disable ();
+	s = lookup (pml4);
+	if (s->pml4 != NULL) {
+		/* Backward-shift deletion: move later entries of the
+		   probe sequence into the hole so that lookups never stop
+		   early at it. */
+		i = s - slots;
+		for (j = (i + 1) % PCID_SLOTS; slots[j].pml4 != NULL;
+				j = (j + 1) % PCID_SLOTS) {
+			size_t home = ((uint64_t) slots[j].pml4 >> PGBITS) % PCID_SLOTS;
+
+			if ((j - home) % PCID_SLOTS >= (j - i) % PCID_SLOTS) {
+				slots[i] = slots[j];
+				i = j;
+			}
+		}
+		slots[i].pml4 = NULL;
+		slot_cnt--;
+	}
+	intr_set_level (old_level);
+}
+
+/* Prints PCID statistics. */
+void
+pcid_print_stats (void) {
+	if (!use_pcid)
+		printf ("PCID: not supported\n");
+	else
+		printf ("PCID: %lld assigned in %lld generations, "
+				"%lld switches kept the TLB, %lld flushed\n",
+				assign_cnt, generation_cnt + 1, noflush_cnt, flush_cnt);
+}
+
+/* Returns the slot for PML4, or the empty slot where it would go.
+   Interrupts must be off. */
+static struct pcid_slot *
+lookup (uint64_t *pml4) {
+	size_t i = ((uint64_t) pml4 >> PGBITS) % PCID_SLOTS;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	while (slots[i].pml4 != NULL && slots[i].pml4 != pml4)
+		i = (i + 1) % PCID_SLOTS;
+	return &slots[i];
+}
+
+/* Forgets every PCID and flushes the whole TLB, so that PCIDs can
+   be handed out again from 1.  Interrupts must be off. */
+static void
+new_generation (void) {
+	size_t i;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	for (i = 0; i < PCID_SLOTS; i++)
+		slots[i].pml4 = NULL;
+	slot_cnt = 0;
+	next_pcid = 1;
+	generation_cnt++;
+
+	if (use_invpcid)
+		invpcid (INVPCID_ALL, 0, 0);
+	else {
+		/* Clearing CR4.PCIDE flushes everything, but requires
+		   PCID 0 to be active. */
+		uint64_t cr4 = rcr4 ();
+
+		lcr3 (vtop (base_pml4));
+		lcr4 (cr4 & ~CR4_PCIDE);
+		lcr4 (cr4);
+	}
+}
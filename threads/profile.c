@@ -0,0 +1,123 @@
+#include "threads/profile.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/loader.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Statistical sampling profiler.
+
+   When enabled, the timer interrupt hands every interrupted
+   frame to profile_sample(), which records the interrupted rip
+   and, for kernel code, up to profile_depth - 1 return addresses
+   found by following the saved frame pointers (the kernel is
+   built with -fno-omit-frame-pointer).  Samples go into a ring
+   buffer that keeps the most recent PROFILE_SAMPLES of them.
+
+   profile_dump(), called at power off, prints the buffer as one
+   "PROF:" line per sample.  "backtrace --profile" folds those
+   lines into flat and call-graph profiles. */
+
+/* Ring buffer size, in pages and in samples. */
+#define PROFILE_PAGES 64
+#define PROFILE_SAMPLES (PROFILE_PAGES * PGSIZE / sizeof (struct sample))
+
+/* One sample. */
+struct sample {
+	uint32_t depth;             /* Number of valid entries in PC. */
+	uint32_t user;              /* Was user code interrupted? */
+	uint64_t pc[PROFILE_DEPTH_MAX]; /* rip, then return addresses. */
+};
+
+bool profile_enabled;
+int profile_depth = 4;
+
+static struct sample *samples;  /* Ring buffer, or NULL if off. */
+static uint64_t sample_cnt;     /* Samples taken since boot. */
+
+/* Allocates the sample buffer if the profiler was enabled on
+   the command line.  Must be called after palloc_init(). */
+void
+profile_init (void) {
+	if (!profile_enabled)
+		return;
+
+	if (profile_depth < 1)
+		profile_depth = 1;
+	else if (profile_depth > PROFILE_DEPTH_MAX)
+		profile_depth = PROFILE_DEPTH_MAX;
+
+	samples = palloc_get_multiple (0, PROFILE_PAGES);
+	if (samples == NULL) {
+		printf ("profile: cannot allocate sample buffer, disabled.\n");
+		profile_enabled = false;
+	}
+}
+
+/* Records a sample of the code interrupted by F.  Called by the
+   timer interrupt handler. */
+void
+profile_sample (const struct intr_frame *f) {
+	struct sample *s;
+
+	ASSERT (intr_context ());
+
+	if (samples == NULL)
+		return;
+
+	s = &samples[sample_cnt++ % PROFILE_SAMPLES];
+	s->pc[0] = f->rip;
+	s->depth = 1;
+	s->user = f->cs != SEL_KCSEG;
+
+	/* Walk the frame pointer chain, but only within the
+	   interrupted thread's kernel stack page, and only upward,
+	   so that a garbage rbp cannot make us fault or loop.  User
+	   stacks are not walked from interrupt context. */
+	if (!s->user) {
+		uintptr_t lo = (uintptr_t) pg_round_down ((void *) f->rsp);
+		uintptr_t hi = lo + PGSIZE - 2 * sizeof (uint64_t);
+		uint64_t *frame = (uint64_t *) f->R.rbp;
+
+		while (s->depth < (uint32_t) profile_depth
+				&& (uintptr_t) frame >= lo && (uintptr_t) frame <= hi
+				&& (uintptr_t) frame % sizeof *frame == 0
+				&& frame[1] != 0) {
+			s->pc[s->depth++] = frame[1];
+			if (frame[0] <= (uint64_t) frame)
+				break;
+			frame = (uint64_t *) frame[0];
+		}
+	}
+}
+
+/* Stops sampling and prints the samples in the ring buffer,
+   oldest first. */
+void
+profile_dump (void) {
+	const struct sample *buf;
+	enum intr_level old_level;
+	uint64_t first, i;
+
+	old_level = intr_disable ();
+	buf = samples;
+	samples = NULL;
+	intr_set_level (old_level);
+	if (buf == NULL)
+		return;
+
+	first = sample_cnt > PROFILE_SAMPLES ? sample_cnt - PROFILE_SAMPLES : 0;
+	printf ("Profile: %"PRIu64" samples, %"PRIu64" kept, depth %d.\n",
+			sample_cnt, sample_cnt - first, profile_depth);
+	for (i = first; i < sample_cnt; i++) {
+		const struct sample *s = &buf[i % PROFILE_SAMPLES];
+		uint32_t d;
+
+		printf ("PROF: %c", s->user ? 'U' : 'K');
+		for (d = 0; d < s->depth; d++)
+			printf (" %#"PRIx64, s->pc[d]);
+		printf ("\n");
+	}
+}
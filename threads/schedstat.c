@@ -0,0 +1,146 @@
+#include "threads/schedstat.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+#include "intrinsic.h"
+
+/* Scheduler latency statistics and event trace.
+
+   schedule() reports, for every thread it switches to, how long
+   that thread sat in the ready queue: since it was woken, or
+   since it was preempted.  The two kinds of latency are kept in
+   separate histograms with power-of-two buckets, in TSC cycles.
+
+   With -schedstat, scheduling events are also logged as binary
+   records into a ring buffer that keeps the most recent
+   SCHED_EVENTS of them.  schedstat_dump() prints the ring as one
+   "SCHED:" line per event; a test may call it to see exactly
+   how its threads were scheduled.  All of this is called with
+   interrupts off. */
+
+/* Latency histogram buckets.  Bucket N counts latencies of
+   2**(N-1) to 2**N - 1 cycles; bucket 0 counts zero. */
+#define HIST_BUCKETS 48
+
+/* Trace ring size, in pages and in events. */
+#define SCHED_PAGES 32
+#define SCHED_EVENTS (SCHED_PAGES * PGSIZE / sizeof (struct sched_event))
+
+/* One trace record. */
+struct sched_event {
+	uint64_t tsc;               /* TSC at the event. */
+	int32_t tid;                /* Thread the event is about. */
+	uint32_t type;              /* A SCHED_* event type. */
+	int64_t arg;                /* Type-specific argument. */
+};
+
+bool schedstat_enabled;
+
+static uint64_t wakeup_hist[HIST_BUCKETS];  /* Wakeup to run. */
+static uint64_t preempt_hist[HIST_BUCKETS]; /* Preemption to run. */
+
+static struct sched_event *events;      /* Trace ring, or NULL if off. */
+static uint64_t event_cnt;              /* Events logged since boot. */
+
+/* Allocates the trace ring if -schedstat was given.  Must be
+   called after palloc_init(). */
+void
+schedstat_init (void) {
+	if (!schedstat_enabled)
+		return;
+
+	events = palloc_get_multiple (0, SCHED_PAGES);
+	if (events == NULL)
+		printf ("schedstat: cannot allocate trace ring, tracing disabled.\n");
+}
+
+/* Logs an event of TYPE about thread TID, if tracing is on. */
+void
+schedstat_event (enum sched_event_type type, int tid, int64_t arg) {
+	struct sched_event *e;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (events == NULL)
+		return;
+
+	e = &events[event_cnt++ % SCHED_EVENTS];
+	e->tsc = rdtsc ();
+	e->tid = tid;
+	e->type = type;
+	e->arg = arg;
+}
+
+/* Records that a thread waited CYCLES in the ready queue after
+   being woken, if WAKEUP, or preempted, otherwise. */
+void
+schedstat_latency (bool wakeup, uint64_t cycles) {
+	int bucket = 0;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	while (cycles != 0 && bucket < HIST_BUCKETS - 1) {
+		cycles >>= 1;
+		bucket++;
+	}
+	(wakeup ? wakeup_hist : preempt_hist)[bucket]++;
+}
+
+/* Prints histogram HIST, titled NAME, skipping empty buckets. */
+static void
+print_hist (const char *name, const uint64_t hist[HIST_BUCKETS]) {
+	uint64_t total = 0;
+	int i;
+
+	for (i = 0; i < HIST_BUCKETS; i++)
+		total += hist[i];
+	printf ("%s latency, %"PRIu64" samples:\n", name, total);
+	for (i = 0; i < HIST_BUCKETS; i++)
+		if (hist[i] != 0) {
+			uint64_t limit = i == 0 ? 0 : (1ULL << i) - 1;
+			printf ("  <= %10"PRId64" ns: %"PRIu64"\n",
+					timer_cycles_to_ns (limit), hist[i]);
+		}
+}
+
+/* Prints the ready-queue latency histograms. */
+void
+schedstat_print (void) {
+	print_hist ("Wakeup", wakeup_hist);
+	print_hist ("Preemption", preempt_hist);
+}
+
+/* Prints the trace ring, oldest event first.  Tracing is paused
+   while printing, so that the output itself is not traced. */
+void
+schedstat_dump (void) {
+	static const char *names[] = { "wakeup", "preempt", "switch", "exit" };
+	struct sched_event *buf;
+	enum intr_level old_level;
+	uint64_t first, cnt, i;
+
+	old_level = intr_disable ();
+	buf = events;
+	events = NULL;
+	cnt = event_cnt;
+	intr_set_level (old_level);
+	if (buf == NULL)
+		return;
+
+	first = cnt > SCHED_EVENTS ? cnt - SCHED_EVENTS : 0;
+	printf ("Scheduler trace: %"PRIu64" events, %"PRIu64" kept.\n",
+			cnt, cnt - first);
+	for (i = first; i < cnt; i++) {
+		const struct sched_event *e = &buf[i % SCHED_EVENTS];
+		printf ("SCHED: %"PRIu64" %s %d %"PRId64"\n",
+				e->tsc, names[e->type], e->tid, e->arg);
+	}
+
+	old_level = intr_disable ();
+	events = buf;
+	intr_set_level (old_level);
+}
@@ -0,0 +1,348 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Slab allocator.
+
+   A cache hands out objects of a single, exact size, which saves
+   the space malloc() loses rounding sizes up to a power of two:
+   a 550-byte object takes a 1024-byte malloc() block, but a
+   cache fits 7 of them in a page.
+
+   Each page obtained for a cache is a "slab": a struct slab
+   header followed by as many objects as fit.  Every object is
+   followed by a pointer that links it into its slab's free list
+   while it is free.  Keeping the link outside the object means
+   that an object's contents survive a free, so a cache's
+   constructor runs only once per object, when its slab is
+   created, and callers must free objects in their constructed
+   state.  Caches without a constructor are poisoned on free in
+   debug builds, as malloc() blocks are.
+
+   A cache keeps its slabs on three lists: full, partial, and
+   empty.  Allocation takes from a partial slab, then an empty
+   one, and only then gets a new page.  At most one empty slab is
+   kept, so that an object allocated and freed over and over does
+   not get and free a page each time.  The page allocator takes
+   the empty slabs back through slab_reclaim() when it runs out of
+   pages.
+
+   free() recognizes slab objects by the magic number in their
+   page's header and passes them to kmem_cache_free(), so an
+   object from a cache may be released either way. */
+
+/* Magic number for detecting slab corruption.  Differs from
+   malloc()'s ARENA_MAGIC, which sits at the same offset. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Number of empty slabs a cache keeps. */
+#define EMPTY_SLABS_MAX 1
+
+/* A cache. */
+struct kmem_cache {
+	const char *name;           /* Name, for statistics. */
+	size_t size;                /* Object size as requested. */
+	size_t stride;              /* Bytes from one object to the next. */
+	size_t first;               /* Offset of first object in slab. */
+	size_t objs_per_slab;       /* Number of objects in a slab. */
+	kmem_ctor_func *ctor;       /* Constructor, or NULL. */
+	struct lock lock;           /* Protects everything below. */
+	struct list full;           /* Slabs with no free objects. */
+	struct list partial;        /* Slabs with some free objects. */
+	struct list empty;          /* Slabs with only free objects. */
+	size_t slab_cnt;            /* Number of slabs. */
+	size_t empty_cnt;           /* Number of slabs in EMPTY. */
+	size_t active;              /* Objects in use. */
+	uint64_t alloc_cnt;         /* Objects allocated since creation. */
+	uint64_t free_cnt;          /* Objects freed since creation. */
+	struct list_elem elem;      /* Element in all_caches. */
+};
+
+/* A slab, at the start of its page. */
+struct slab {
+	unsigned magic;             /* Always set to SLAB_MAGIC. */
+	struct kmem_cache *cache;   /* Owning cache. */
+	struct list_elem elem;      /* Element in one of cache's lists. */
+	void *free;                 /* First free object, or NULL. */
+	size_t in_use;              /* Objects in use. */
+};
+
+/* All caches, for statistics and reclaiming.  Protected by
+   disabling interrupts.  Caches are never removed, so a walk may
+   reenable interrupts between steps; see next_cache(). */
+static struct list all_caches;
+
+static struct list_elem *next_cache (struct list_elem *);
+static struct slab *slab_create (struct kmem_cache *);
+static size_t slab_reclaim (void);
+static struct slab *obj_to_slab (const void *);
+
+/* Returns the free-list link that follows OBJ in cache C. */
+static inline void **
+obj_link (const struct kmem_cache *c, void *obj) {
+	return (void **) ((uint8_t *) obj + c->stride - sizeof (void *));
+}
+
+/* Initializes the slab allocator. */
+void
+slab_init (void) {
+	list_init (&all_caches);
+	palloc_add_reclaim (slab_reclaim);
+}
+
+/* Creates and returns a cache named NAME for objects of SIZE
+   bytes, each aligned to ALIGN bytes, a power of two, or to a
+   pointer if ALIGN is 0.  CTOR, if not null, is called on each
+   object once, when the memory for it is first obtained.
+   Returns a null pointer if memory is not available. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, size_t align,
+		kmem_ctor_func *ctor) {
+	struct kmem_cache *c;
+	enum intr_level old_level;
+
+	ASSERT (name != NULL);
+	ASSERT (size > 0);
+	ASSERT ((align & (align - 1)) == 0);
+
+	if (align < sizeof (void *))
+		align = sizeof (void *);
+
+	c = malloc (sizeof *c);
+	if (c == NULL)
+		return NULL;
+
+	c->name = name;
+	c->size = size;
+	c->stride = ROUND_UP (ROUND_UP (size, sizeof (void *)) + sizeof (void *),
+			align);
+	c->first = ROUND_UP (sizeof (struct slab), align);
+	c->objs_per_slab = (PGSIZE - c->first) / c->stride;
+	ASSERT (c->objs_per_slab > 0);
+	c->ctor = ctor;
+	lock_init (&c->lock);
+	list_init (&c->full);
+	list_init (&c->partial);
+	list_init (&c->empty);
+	c->slab_cnt = c->empty_cnt = c->active = 0;
+	c->alloc_cnt = c->free_cnt = 0;
+
+	old_level = intr_disable ();
+	list_push_back (&all_caches, &c->elem);
+	intr_set_level (old_level);
+
+	return c;
+}
+
+/* Allocates and returns an object from cache C, or a null
+   pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c) {
+	struct slab *s;
+	void *obj;
+
+	ASSERT (c != NULL);
+
+	lock_acquire (&c->lock);
+	if (!list_empty (&c->partial))
+		s = list_entry (list_front (&c->partial), struct slab, elem);
+	else if (!list_empty (&c->empty)) {
+		s = list_entry (list_pop_front (&c->empty), struct slab, elem);
+		c->empty_cnt--;
+		list_push_front (&c->partial, &s->elem);
+	} else {
+		s = slab_create (c);
+		if (s == NULL) {
+			lock_release (&c->lock);
+			return NULL;
+		}
+		list_push_front (&c->partial, &s->elem);
+	}
+
+	obj = s->free;
+	s->free = *obj_link (c, obj);
+	if (++s->in_use == c->objs_per_slab) {
+		list_remove (&s->elem);
+		list_push_front (&c->full, &s->elem);
+	}
+	c->active++;
+	c->alloc_cnt++;
+	lock_release (&c->lock);
+
+	return obj;
+}
+
+/* Returns OBJ, which must have been allocated from cache C, to
+   C.  If C has a constructor, OBJ must be in its constructed
+   state. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj) {
+	struct slab *s;
+
+	if (obj == NULL)
+		return;
+
+	s = obj_to_slab (obj);
+	ASSERT (s->cache == c);
+
+#ifndef NDEBUG
+	/* Clear the object to help detect use-after-free bugs. */
+	if (c->ctor == NULL)
+		memset (obj, 0xcc, c->size);
+#endif
+
+	lock_acquire (&c->lock);
+	*obj_link (c, obj) = s->free;
+	s->free = obj;
+	if (s->in_use-- == c->objs_per_slab) {
+		list_remove (&s->elem);
+		list_push_front (&c->partial, &s->elem);
+	}
+	if (s->in_use == 0) {
+		list_remove (&s->elem);
+		if (c->empty_cnt < EMPTY_SLABS_MAX) {
+			list_push_front (&c->empty, &s->elem);
+			c->empty_cnt++;
+		} else {
+			s->magic = 0;
+			palloc_free_page (s);
+			c->slab_cnt--;
+		}
+	}
+	c->active--;
+	c->free_cnt++;
+	lock_release (&c->lock);
+}
+
+/* Prints statistics for every cache, if there are any. */
+void
+kmem_cache_print_stats (void) {
+	struct list_elem *e;
+
+	e = next_cache (NULL);
+	if (e == list_end (&all_caches))
+		return;
+	printf ("Slab caches:\n");
+	for (; e != list_end (&all_caches); e = next_cache (e)) {
+		struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+		size_t used = c->active * c->size;
+		size_t total = c->slab_cnt * PGSIZE;
+
+		printf ("  %-12s %4zu bytes, %3zu per slab: %zu active in %zu slabs "
+				"(%zu%% used), %llu allocs, %llu frees\n",
+				c->name, c->size, c->objs_per_slab, c->active, c->slab_cnt,
+				total != 0 ? used * 100 / total : 0,
+				c->alloc_cnt, c->free_cnt);
+	}
+}
+
+/* Returns true if P points into a slab, false if it points into
+   a malloc() arena. */
+bool
+slab_owns (const void *p) {
+	return ((const struct slab *) pg_round_down (p))->magic == SLAB_MAGIC;
+}
+
+/* Frees P, an object of whatever cache owns its slab. */
+void
+slab_free (void *p) {
+	kmem_cache_free (obj_to_slab (p)->cache, p);
+}
+
+/* Returns the size of P, an object in a slab. */
+size_t
+slab_object_size (const void *p) {
+	return obj_to_slab (p)->cache->size;
+}
+
+/* Frees the empty slabs of every cache that is not busy.
+   Returns the number of pages freed.  Called by the page
+   allocator when it runs out of pages. */
+static size_t
+slab_reclaim (void) {
+	struct list_elem *e;
+	size_t freed = 0;
+
+	for (e = next_cache (NULL); e != list_end (&all_caches);
+			e = next_cache (e)) {
+		struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+
+		if (lock_held_by_current_thread (&c->lock)
+				|| !lock_try_acquire (&c->lock))
+			continue;
+		while (!list_empty (&c->empty)) {
+			struct slab *s = list_entry (list_pop_front (&c->empty),
+					struct slab, elem);
+
+			s->magic = 0;
+			palloc_free_page (s);
+			c->empty_cnt--;
+			c->slab_cnt--;
+			freed++;
+		}
+		lock_release (&c->lock);
+	}
+	return freed;
+}
+
+/* Returns the element of all_caches after E, or its first
+   element if E is null.  Reads the links with interrupts off, so
+   that kmem_cache_create() cannot append a cache halfway
+   through. */
+static struct list_elem *
+next_cache (struct list_elem *e) {
+	enum intr_level old_level;
+
+	old_level = intr_disable ();
+	e = e != NULL ? list_next (e) : list_begin (&all_caches);
+	intr_set_level (old_level);
+	return e;
+}
+
+/* Gets a page for a new slab of cache C and constructs its
+   objects.  C's lock must be held. */
+static struct slab *
+slab_create (struct kmem_cache *c) {
+	struct slab *s;
+	size_t i;
+
+	ASSERT (lock_held_by_current_thread (&c->lock));
+
+	s = palloc_get_page (0);
+	if (s == NULL)
+		return NULL;
+
+	s->magic = SLAB_MAGIC;
+	s->cache = c;
+	s->free = NULL;
+	s->in_use = 0;
+	for (i = c->objs_per_slab; i-- > 0; ) {
+		void *obj = (uint8_t *) s + c->first + i * c->stride;
+
+		if (c->ctor != NULL)
+			c->ctor (obj);
+		*obj_link (c, obj) = s->free;
+		s->free = obj;
+	}
+	c->slab_cnt++;
+	return s;
+}
+
+/* Returns the slab that OBJ is in. */
+static struct slab *
+obj_to_slab (const void *obj) {
+	struct slab *s = pg_round_down (obj);
+
+	ASSERT (s->magic == SLAB_MAGIC);
+	ASSERT ((pg_ofs (obj) - s->cache->first) % s->cache->stride == 0);
+	return s;
+}
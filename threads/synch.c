@@ -27,10 +27,15 @@
    */
 
 #include "threads/synch.h"
+#include <limits.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/interrupt.h"
+#include "threads/lockstat.h"
 #include "threads/thread.h"
+#include "intrinsic.h"
+
+static bool sema_down_wait (struct semaphore *, uint64_t *wait_cycles);
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -60,17 +65,43 @@ sema_init (struct semaphore *sema, unsigned value) {
 void
 sema_down (struct semaphore *sema) {
 	enum intr_level old_level;
+	uint64_t wait_cycles;
+	bool contended;
 
 	ASSERT (sema != NULL);
 	ASSERT (!intr_context ());
 
 	old_level = intr_disable ();
+	contended = sema_down_wait (sema, &wait_cycles);
+	if (lockstat_enabled)
+		lockstat_acquired (lockstat_sema_class (), contended, wait_cycles);
+	intr_set_level (old_level);
+}
+
+/* Does the work of sema_down() with interrupts off.  Returns
+   true if we had to sleep, storing the time slept into
+   *WAIT_CYCLES if lockstat is on. */
+static bool
+sema_down_wait (struct semaphore *sema, uint64_t *wait_cycles) {
+	uint64_t start;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	*wait_cycles = 0;
+	if (sema->value > 0) {
+		sema->value--;
+		return false;
+	}
+
+	start = lockstat_enabled ? rdtsc () : 0;
 	while (sema->value == 0) {
 		list_push_back (&sema->waiters, &thread_current ()->elem);
 		thread_block ();
 	}
 	sema->value--;
-	intr_set_level (old_level);
+	if (lockstat_enabled)
+		*wait_cycles = rdtsc () - start;
+	return true;
 }
 
 /* Down or "P" operation on a semaphore, but only if the
@@ -99,7 +130,12 @@ sema_try_down (struct semaphore *sema) {
 }
 
 /* Up or "V" operation on a semaphore.  Increments SEMA's value
-   and wakes up one thread of those waiting for SEMA, if any.
+   and wakes up the highest-priority thread of those waiting for
+   SEMA, if any, preempting the caller if that thread outranks it.
+
+   Waiters are kept in arrival order rather than sorted, because a
+   waiter's priority can rise through donation while it sleeps;
+   picking the maximum here always sees current priorities.
 
    This function may be called from an interrupt handler. */
 void
@@ -109,11 +145,16 @@ sema_up (struct semaphore *sema) {
 	ASSERT (sema != NULL);
 
 	old_level = intr_disable ();
-	if (!list_empty (&sema->waiters))
-		thread_unblock (list_entry (list_pop_front (&sema->waiters),
-					struct thread, elem));
+	if (!list_empty (&sema->waiters)) {
+		struct list_elem *e = list_min (&sema->waiters, compare_priority, NULL);
+		list_remove (e);
+		thread_unblock (list_entry (e, struct thread, elem));
+	}
 	sema->value++;
 	intr_set_level (old_level);
+
+	/* project1 priority */
+	thread_preempt ();
 }
 
 static void sema_test_helper (void *sema_);
@@ -165,31 +206,59 @@ sema_test_helper (void *sema_) {
    another one "up" it, but with a lock the same thread must both
    acquire and release it.  When these restrictions prove
    onerous, it's a good sign that a semaphore should be used,
-   instead of a lock. */
+   instead of a lock.
+
+   NAME identifies the lock in lock statistics.  Call this
+   through the lock_init() macro, which passes the text of its
+   argument. */
 void
-lock_init (struct lock *lock) {
+lock_init_named (struct lock *lock, const char *name) {
 	ASSERT (lock != NULL);
 
 	lock->holder = NULL;
 	sema_init (&lock->semaphore, 1);
+	lock->stat = lockstat_enabled ? lockstat_class (name) : NULL;
+	lock->acquire_tsc = 0;
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
    necessary.  The lock must not already be held by the current
    thread.
 
+   If the lock is held, the current thread donates its priority
+   to the holder, and through it to every thread further along
+   the chain of lock holders, until the lock is handed over.
+
    This function may sleep, so it must not be called within an
    interrupt handler.  This function may be called with
    interrupts disabled, but interrupts will be turned back on if
    we need to sleep. */
 void
 lock_acquire (struct lock *lock) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+	uint64_t wait_cycles;
+	bool contended;
+
 	ASSERT (lock != NULL);
 	ASSERT (!intr_context ());
 	ASSERT (!lock_held_by_current_thread (lock));
 
-	sema_down (&lock->semaphore);
-	lock->holder = thread_current ();
+	old_level = intr_disable ();
+	/* project1 priority donation */
+	if (lock->holder != NULL && !thread_mlfqs) {
+		curr->wait_on_lock = lock;
+		list_push_back (&lock->holder->donations, &curr->donation_elem);
+		thread_donate_priority (curr);
+	}
+	contended = sema_down_wait (&lock->semaphore, &wait_cycles);
+	curr->wait_on_lock = NULL;
+	lock->holder = curr;
+	if (lock->stat != NULL) {
+		lockstat_acquired (lock->stat, contended, wait_cycles);
+		lock->acquire_tsc = rdtsc ();
+	}
+	intr_set_level (old_level);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -206,24 +275,52 @@ lock_try_acquire (struct lock *lock) {
 	ASSERT (!lock_held_by_current_thread (lock));
 
 	success = sema_try_down (&lock->semaphore);
-	if (success)
+	if (success) {
 		lock->holder = thread_current ();
+		if (lock->stat != NULL) {
+			enum intr_level old_level = intr_disable ();
+			lockstat_acquired (lock->stat, false, 0);
+			lock->acquire_tsc = rdtsc ();
+			intr_set_level (old_level);
+		}
+	}
 	return success;
 }
 
 /* Releases LOCK, which must be owned by the current thread.
-   This is lock_release function.
+   This is lock_release function.  Donations received from the
+   threads waiting on LOCK are returned and the current thread's
+   priority is recomputed from the donations it still holds.
 
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to release a lock within an interrupt
    handler. */
 void
 lock_release (struct lock *lock) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+	struct list_elem *e;
+
 	ASSERT (lock != NULL);
 	ASSERT (lock_held_by_current_thread (lock));
 
+	old_level = intr_disable ();
+	/* project1 priority donation */
+	if (!thread_mlfqs) {
+		for (e = list_begin (&curr->donations); e != list_end (&curr->donations);) {
+			struct thread *donor = list_entry (e, struct thread, donation_elem);
+			if (donor->wait_on_lock == lock)
+				e = list_remove (e);
+			else
+				e = list_next (e);
+		}
+		thread_refresh_priority (curr);
+	}
+	if (lock->stat != NULL)
+		lockstat_released (lock->stat, rdtsc () - lock->acquire_tsc);
 	lock->holder = NULL;
 	sema_up (&lock->semaphore);
+	intr_set_level (old_level);
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -240,8 +337,18 @@ lock_held_by_current_thread (const struct lock *lock) {
 struct semaphore_elem {
 	struct list_elem elem;              /* List element. */
 	struct semaphore semaphore;         /* This semaphore. */
+	struct thread *thread;              /* Thread waiting on it. */
 };
 
+/* Returns true if the thread waiting on semaphore_elem A has a
+   higher priority than the one waiting on B. */
+static bool
+compare_waiter_priority (const struct list_elem *a,
+		const struct list_elem *b, void *aux UNUSED) {
+	return list_entry (a, struct semaphore_elem, elem)->thread->priority
+		> list_entry (b, struct semaphore_elem, elem)->thread->priority;
+}
+
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
    code to receive the signal and act upon it. */
@@ -282,6 +389,7 @@ cond_wait (struct condition *cond, struct lock *lock) {
 	ASSERT (lock_held_by_current_thread (lock));
 
 	sema_init (&waiter.semaphore, 0);
+	waiter.thread = thread_current ();
 	list_push_back (&cond->waiters, &waiter.elem);
 	lock_release (lock);
 	sema_down (&waiter.semaphore);
@@ -289,8 +397,9 @@ cond_wait (struct condition *cond, struct lock *lock) {
 }
 
 /* If any threads are waiting on COND (protected by LOCK), then
-   this function signals one of them to wake up from its wait.
-   LOCK must be held before calling this function.
+   this function signals the highest-priority one of them to wake
+   up from its wait.  LOCK must be held before calling this
+   function.
 
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to signal a condition variable within an
@@ -302,9 +411,12 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED) {
 	ASSERT (!intr_context ());
 	ASSERT (lock_held_by_current_thread (lock));
 
-	if (!list_empty (&cond->waiters))
-		sema_up (&list_entry (list_pop_front (&cond->waiters),
-					struct semaphore_elem, elem)->semaphore);
+	if (!list_empty (&cond->waiters)) {
+		struct list_elem *e = list_min (&cond->waiters,
+				compare_waiter_priority, NULL);
+		list_remove (e);
+		sema_up (&list_entry (e, struct semaphore_elem, elem)->semaphore);
+	}
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -321,3 +433,249 @@ cond_broadcast (struct condition *cond, struct lock *lock) {
 	while (!list_empty (&cond->waiters))
 		cond_signal (cond, lock);
 }
+
+/* One thread in a wait queue. */
+struct wait_queue_elem {
+	struct list_elem elem;              /* List element. */
+	struct thread *thread;              /* Waiting thread. */
+	uintptr_t key;                      /* Key it is waiting on. */
+};
+
+/* Initializes wait queue WQ to be empty. */
+void
+wait_queue_init (struct wait_queue *wq) {
+	ASSERT (wq != NULL);
+
+	list_init (&wq->waiters);
+}
+
+/* Puts the current thread to sleep on WQ, tagged with KEY, until
+   a wait_queue_wake_*() call selects it.
+
+   This function must be called with interrupts turned off, after
+   the caller has checked that the event it waits for has not
+   already happened.  It may sleep, so it must not be called
+   within an interrupt handler.  Interrupts are still off when it
+   returns. */
+void
+wait_queue_wait (struct wait_queue *wq, uintptr_t key) {
+	struct wait_queue_elem waiter;
+
+	ASSERT (wq != NULL);
+	ASSERT (!intr_context ());
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	waiter.thread = thread_current ();
+	waiter.key = key;
+	list_push_back (&wq->waiters, &waiter.elem);
+	thread_block ();
+}
+
+/* Returns true if no thread is waiting on WQ. */
+bool
+wait_queue_empty (struct wait_queue *wq) {
+	ASSERT (wq != NULL);
+
+	return list_empty (&wq->waiters);
+}
+
+/* Wakes up to MAX threads waiting on WQ, highest priority first.
+   If ANY is false, only threads waiting on KEY are candidates.
+   Stores the last thread woken in *LAST, if LAST is nonnull, and
+   returns the number woken.  Interrupts must be off. */
+static int
+wake_waiters (struct wait_queue *wq, bool any, uintptr_t key, int max,
+		struct thread **last) {
+	int woken = 0;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	while (woken < max) {
+		struct wait_queue_elem *best = NULL;
+		struct list_elem *e;
+
+		for (e = list_begin (&wq->waiters); e != list_end (&wq->waiters);
+				e = list_next (e)) {
+			struct wait_queue_elem *w = list_entry (e, struct wait_queue_elem, elem);
+			if ((any || w->key == key)
+					&& (best == NULL || w->thread->priority > best->thread->priority))
+				best = w;
+		}
+		if (best == NULL)
+			break;
+
+		list_remove (&best->elem);
+		thread_unblock (best->thread);
+		if (last != NULL)
+			*last = best->thread;
+		woken++;
+	}
+	return woken;
+}
+
+/* Wakes the highest-priority thread waiting on WQ, whatever its
+   key, and returns it, or returns a null pointer if WQ is empty.
+   The woken thread may preempt the caller.
+
+   This function may be called from an interrupt handler. */
+struct thread *
+wait_queue_wake_one (struct wait_queue *wq) {
+	struct thread *t = NULL;
+	enum intr_level old_level;
+
+	ASSERT (wq != NULL);
+
+	old_level = intr_disable ();
+	wake_waiters (wq, true, 0, 1, &t);
+	intr_set_level (old_level);
+
+	thread_preempt ();
+	return t;
+}
+
+/* Wakes every thread waiting on WQ and returns how many there
+   were.
+
+   This function may be called from an interrupt handler. */
+int
+wait_queue_wake_all (struct wait_queue *wq) {
+	enum intr_level old_level;
+	int woken;
+
+	ASSERT (wq != NULL);
+
+	old_level = intr_disable ();
+	woken = wake_waiters (wq, true, 0, INT_MAX, NULL);
+	intr_set_level (old_level);
+
+	thread_preempt ();
+	return woken;
+}
+
+/* Wakes up to MAX of the threads waiting on WQ with KEY, highest
+   priority first, and returns how many were woken.
+
+   This function may be called from an interrupt handler. */
+int
+wait_queue_wake_key (struct wait_queue *wq, uintptr_t key, int max) {
+	enum intr_level old_level;
+	int woken;
+
+	ASSERT (wq != NULL);
+
+	old_level = intr_disable ();
+	woken = wake_waiters (wq, false, key, max, NULL);
+	intr_set_level (old_level);
+
+	thread_preempt ();
+	return woken;
+}
+
+/* Initializes RW as an unheld reader/writer lock.  Any number of
+   readers may hold it at once, or a single writer.
+
+   Writers take precedence: once a writer is waiting, new readers
+   queue behind it, so a steady stream of readers cannot starve
+   writers out.  When a writer releases the lock and no other
+   writer is waiting, every queued reader is admitted in one
+   batch.  Ownership is handed directly to the threads woken, so
+   a newcomer cannot slip in ahead of them.
+
+   Like semaphores, and unlike locks, rwlocks do not donate
+   priority. */
+void
+rwlock_init (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	rw->readers = 0;
+	rw->writer = NULL;
+	wait_queue_init (&rw->read_wq);
+	wait_queue_init (&rw->write_wq);
+}
+
+/* Acquires RW for reading, sleeping while a writer holds it or
+   is waiting for it.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (!intr_context ());
+	ASSERT (rw->writer != thread_current ());
+
+	old_level = intr_disable ();
+	if (rw->writer == NULL && wait_queue_empty (&rw->write_wq))
+		rw->readers++;
+	else
+		wait_queue_wait (&rw->read_wq, 0);
+	intr_set_level (old_level);
+}
+
+/* Releases RW, which the current thread holds for reading.  The
+   last reader out hands the lock to a waiting writer, if any. */
+void
+rwlock_release_read (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+
+	old_level = intr_disable ();
+	ASSERT (rw->readers > 0 && rw->writer == NULL);
+	if (--rw->readers == 0)
+		wake_waiters (&rw->write_wq, true, 0, 1, &rw->writer);
+	intr_set_level (old_level);
+
+	thread_preempt ();
+}
+
+/* Acquires RW for writing, sleeping until no reader or writer
+   holds it.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (!intr_context ());
+	ASSERT (rw->writer != thread_current ());
+
+	old_level = intr_disable ();
+	if (rw->writer == NULL && rw->readers == 0)
+		rw->writer = thread_current ();
+	else
+		wait_queue_wait (&rw->write_wq, 0);
+	ASSERT (rw->writer == thread_current ());
+	intr_set_level (old_level);
+}
+
+/* Releases RW, which the current thread holds for writing.  The
+   lock passes to the next waiting writer if there is one, and
+   otherwise to all waiting readers at once. */
+void
+rwlock_release_write (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (rwlock_held_for_write (rw));
+
+	old_level = intr_disable ();
+	rw->writer = NULL;
+	if (wake_waiters (&rw->write_wq, true, 0, 1, &rw->writer) == 0)
+		rw->readers = wake_waiters (&rw->read_wq, true, 0, INT_MAX, NULL);
+	intr_set_level (old_level);
+
+	thread_preempt ();
+}
+
+/* Returns true if the current thread holds RW for writing. */
+bool
+rwlock_held_for_write (const struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	return rw->writer == thread_current ();
+}
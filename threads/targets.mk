@@ -2,8 +2,16 @@ threads_SRC  = threads/init.c		# Main program.
 threads_SRC += threads/thread.c		# Thread management core.
 threads_SRC += threads/interrupt.c	# Interrupt core.
 threads_SRC += threads/intr-stubs.S	# Interrupt stubs.
+threads_SRC += threads/switch.S		# Thread switch routine.
 threads_SRC += threads/synch.c		# Synchronization.
+threads_SRC += threads/lockstat.c	# Lock contention statistics.
+threads_SRC += threads/workqueue.c	# Deferred work in kernel threads.
+threads_SRC += threads/fpu.c		# Lazy FPU context switching.
+threads_SRC += threads/profile.c	# Sampling profiler.
+threads_SRC += threads/schedstat.c	# Scheduler statistics and tracing.
 threads_SRC += threads/palloc.c		# Page allocator.
 threads_SRC += threads/malloc.c		# Subpage allocator.
+threads_SRC += threads/slab.c		# Slab allocator.
 threads_SRC += threads/start.S		# Startup code.
 threads_SRC += threads/mmu.c		    # Memory management unit related things.
+threads_SRC += threads/pcid.c		# Process-context identifiers.
@@ -1,15 +1,21 @@
 #include "threads/thread.h"
 #include <debug.h>
+#include <inttypes.h>
 #include <stddef.h>
 #include <random.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/flags.h"
+#include "threads/fpu.h"
 #include "threads/interrupt.h"
+#include "threads/lockstat.h"
 #include "threads/intr-stubs.h"
 #include "threads/palloc.h"
+#include "threads/schedstat.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "threads/workqueue.h"
+#include "devices/timer.h"
 #include "intrinsic.h"
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -30,6 +36,17 @@ static struct list ready_list;
 /* project 1 alarm clock */
 static struct list sleep_list;
 
+/* Earliest-deadline-first class.  EDF threads that are ready to
+   run wait in edf_ready_list, ordered by deadline, instead of in
+   ready_list, and are always chosen before any thread in
+   ready_list.  EDF threads waiting for their next period, either
+   because their job is done or because they used up their
+   budget, wait in edf_wait_list, ordered by release time. */
+static struct list edf_ready_list;
+static struct list edf_wait_list;
+static int edf_util;            /* Admitted density, per mille. */
+#define EDF_UTIL_MAX 950        /* Admission limit, per mille. */
+
 /* Idle thread. */
 static struct thread *idle_thread;
 
@@ -39,8 +56,22 @@ static struct thread *initial_thread;
 /* Lock used by allocate_tid(). */
 static struct lock tid_lock;
 
+/* List of all threads.  Threads are added to this list when
+   they are created and removed when they exit. */
+static struct list all_list;
+
 /* Thread destruction requests */
 static struct list destruction_req;
+static size_t destruction_cnt;  /* # of threads in destruction_req. */
+
+/* Pages of dead threads kept for reuse by thread_create(), so
+   that churning threads neither goes back to the page allocator
+   nor zeroes a whole page each time.  Holds at most
+   THREAD_CACHE_MAX pages. */
+#define THREAD_CACHE_MAX 16
+#define RECLAIM_BATCH 8         /* Reclaim when this many are dead. */
+static struct list thread_cache;
+static size_t thread_cache_cnt;
 
 /* Statistics. */
 static long long idle_ticks;    /* # of timer ticks spent idle. */
@@ -49,6 +80,8 @@ static long long user_ticks;    /* # of timer ticks in user programs. */
 
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
+#define LOCKSTAT_TOP_N 10       /* # of locks in the lockstat report. */
+#define DONATION_DEPTH 8        /* Max length of a donation chain. */
 static unsigned thread_ticks;   /* # of timer ticks since last yield. */
 
 /* If false (default), use round-robin scheduler.
@@ -56,13 +89,38 @@ static unsigned thread_ticks;   /* # of timer ticks since last yield. */
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* If false (default), voluntary switches save only callee-saved
+   registers through switch_threads().
+   If true, every switch saves and restores a full intr_frame
+   through thread_launch(), for comparison. */
+bool thread_iret_switch;
+
+/* Switch routines in switch.S. */
+void switch_threads (uint64_t *cur_ksp, uint64_t next_ksp,
+		struct intr_frame *next_tf);
+void switch_threads_resume (void);
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
 static struct thread *next_thread_to_run (void);
 static void init_thread (struct thread *, const char *name, int priority);
-static void do_schedule(int status);
-static void schedule (void);
+static void do_schedule(int status, bool preempted);
+static struct thread *alloc_thread_page (void);
+static void reclaim_threads (void);
+static void print_thread_stats (struct thread *, void *aux);
+static void thread_exit_stats (struct thread *);
+static void ready_insert (struct thread *);
+static bool ready_outranks_current (void);
+static int edf_density (int64_t runtime, int64_t deadline);
+static void edf_replenish (struct thread *);
+static void edf_release (int64_t now);
+static bool compare_deadline (const struct list_elem *,
+		const struct list_elem *, void *aux);
+static bool compare_release (const struct list_elem *,
+		const struct list_elem *, void *aux);
+static void schedule (bool preempted);
+static void yield (bool preempted);
 static tid_t allocate_tid (void);
 
 /* Returns true if T appears to point to a valid thread. */
@@ -112,7 +170,11 @@ thread_init (void) {
 	/* project1 alarm clock */
 	list_init (&ready_list);
 	list_init (&sleep_list);
+	list_init (&edf_ready_list);
+	list_init (&edf_wait_list);
+	list_init (&all_list);
 	list_init (&destruction_req);
+	list_init (&thread_cache);
 
 	/* Set up a thread structure for the running thread. */
 	initial_thread = running_thread ();
@@ -153,6 +215,18 @@ thread_tick (void) {
 	else
 		kernel_ticks++;
 
+	/* Charge EDF threads for the tick, and throttle those that
+	   ran out of budget until their next period.  thread_yield()
+	   does the throttling on the way out of the interrupt. */
+	if (t->edf) {
+		t->edf_job_ticks++;
+		if (--t->edf_budget <= 0) {
+			t->edf_throttled = true;
+			intr_yield_on_return ();
+		}
+	}
+	edf_release (timer_ticks ());
+
 	/* Enforce preemption. */
 	if (++thread_ticks >= TIME_SLICE)
 		intr_yield_on_return ();
@@ -163,6 +237,32 @@ void
 thread_print_stats (void) {
 	printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
 			idle_ticks, kernel_ticks, user_ticks);
+	if (lockstat_enabled)
+		lockstat_print (LOCKSTAT_TOP_N);
+	if (schedstat_enabled) {
+		enum intr_level old_level;
+
+		schedstat_print ();
+		printf ("Threads still alive:\n");
+		old_level = intr_disable ();
+		thread_foreach (print_thread_stats, NULL);
+		intr_set_level (old_level);
+	}
+}
+
+/* Prints T's scheduling statistics. */
+static void
+print_thread_stats (struct thread *t, void *aux UNUSED) {
+	uint64_t now = rdtsc ();
+	uint64_t run = t->run_cycles;
+
+	if (t->status == THREAD_RUNNING)
+		run += now - t->run_tsc;
+	printf ("  %-16s tid %3d: wall %10"PRId64" us, run %10"PRId64" us, "
+			"%u voluntary, %u involuntary switches\n",
+			t->name, t->tid, timer_cycles_to_ns (now - t->start_tsc) / 1000,
+			timer_cycles_to_ns (run) / 1000,
+			t->voluntary_switches, t->involuntary_switches);
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -189,7 +289,7 @@ thread_create (const char *name, int priority,
 	ASSERT (function != NULL);
 
 	/* Allocate thread. */
-	t = palloc_get_page (PAL_ZERO);
+	t = alloc_thread_page ();
 	if (t == NULL)
 		return TID_ERROR;
 
@@ -212,8 +312,7 @@ thread_create (const char *name, int priority,
 	thread_unblock (t);
 
 	/* project1 priority */
-	if (thread_current()->priority < t->priority)
-		thread_yield();
+	thread_preempt ();
 
 	return tid;
 }
@@ -229,7 +328,7 @@ thread_block (void) {
 	ASSERT (!intr_context ());
 	ASSERT (intr_get_level () == INTR_OFF);
 	thread_current ()->status = THREAD_BLOCKED;
-	schedule ();
+	schedule (false);
 }
 
 /* Transitions a blocked thread T to the ready-to-run state.
@@ -249,9 +348,11 @@ thread_unblock (struct thread *t) {
 	old_level = intr_disable ();
 	ASSERT (t->status == THREAD_BLOCKED);
 	/* project1 priority */
-	// list_push_back (&ready_list, &t->elem);
-	list_insert_ordered (&ready_list, &t->elem, &compare_priority, NULL);
+	ready_insert (t);
 	t->status = THREAD_READY;
+	t->ready_tsc = rdtsc ();
+	t->woken = true;
+	schedstat_event (SCHED_WAKEUP, t->tid, running_thread ()->tid);
 	intr_set_level (old_level);
 }
 
@@ -298,7 +399,11 @@ thread_exit (void) {
 	/* Just set our status to dying and schedule another process.
 	   We will be destroyed during the call to schedule_tail(). */
 	intr_disable ();
-	do_schedule (THREAD_DYING);
+	if (thread_current ()->edf)
+		edf_util -= edf_density (thread_current ()->edf_runtime,
+				thread_current ()->edf_deadline);
+	thread_exit_stats (thread_current ());
+	do_schedule (THREAD_DYING, false);
 	NOT_REACHED ();
 }
 
@@ -306,29 +411,97 @@ thread_exit (void) {
    may be scheduled again immediately at the scheduler's whim. */
 void
 thread_yield (void) {
+	yield (false);
+}
+
+/* Like thread_yield(), but counts the switch as involuntary.  For
+   preemption by a higher-priority thread and for the end of a time
+   slice or an EDF budget, through thread_preempt() or
+   intr_yield_on_return(). */
+void
+thread_yield_preempted (void) {
+	yield (true);
+}
+
+/* Yields the CPU, for thread_yield() or thread_yield_preempted()
+   according to PREEMPTED. */
+static void
+yield (bool preempted) {
 	struct thread *curr = thread_current ();
 	enum intr_level old_level;
 
 	ASSERT (!intr_context ());
 
 	old_level = intr_disable ();
+	/* An EDF thread out of budget waits for its next period. */
+	if (curr->edf_throttled) {
+		curr->edf_throttled = false;
+		if (curr->edf_release > timer_ticks ()) {
+			list_insert_ordered (&edf_wait_list, &curr->elem,
+					compare_release, NULL);
+			do_schedule (THREAD_BLOCKED, preempted);
+			intr_set_level (old_level);
+			return;
+		}
+		edf_replenish (curr);
+	}
+
 	/* project1 priority */
 	if (curr != idle_thread){
-		// list_push_back (&ready_list, &curr->elem);
-		list_insert_ordered (&ready_list, &curr->elem, &compare_priority, NULL);
+		ready_insert (curr);
+		curr->ready_tsc = rdtsc ();
+		curr->woken = false;
+		schedstat_event (SCHED_PREEMPT, curr->tid, 0);
 	}
-	do_schedule (THREAD_READY);
+	do_schedule (THREAD_READY, preempted);
 	intr_set_level (old_level);
 }
 
-/* Sets the current thread's priority to NEW_PRIORITY. */
+/* Removes T, which is exiting, from the list of all threads,
+   and reports its statistics if -schedstat was given.  Must be
+   called with interrupts off. */
+static void
+thread_exit_stats (struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	list_remove (&t->allelem);
+	if (schedstat_enabled) {
+		print_thread_stats (t, NULL);
+		schedstat_event (SCHED_EXIT, t->tid,
+				t->run_cycles + (rdtsc () - t->run_tsc));
+	}
+}
+
+/* Invokes function FUNC on all threads, passing along AUX.
+   This function must be called with interrupts off. */
+void
+thread_foreach (thread_action_func *func, void *aux) {
+	struct list_elem *e;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	for (e = list_begin (&all_list); e != list_end (&all_list);
+			e = list_next (e)) {
+		struct thread *t = list_entry (e, struct thread, allelem);
+		func (t, aux);
+	}
+}
+
+/* Sets the current thread's priority to NEW_PRIORITY.  If the
+   thread has received donations, its effective priority does not
+   drop below the highest of them until they are returned. */
 void
 thread_set_priority (int new_priority) {
-	thread_current ()->priority = new_priority;
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+
+	old_level = intr_disable ();
+	curr->init_priority = new_priority;
+	thread_refresh_priority (curr);
+	intr_set_level (old_level);
+
 	/* project1 priority */
-	if (list_empty(&ready_list)) return;
-	if (list_entry(list_begin(&ready_list), struct thread, elem)->priority > thread_current()->priority)
-		thread_yield();
+	thread_preempt ();
 }
 
 /* Returns the current thread's priority. */
@@ -385,6 +558,13 @@ idle (void *idle_started_ UNUSED) {
 		intr_disable ();
 		thread_block ();
 
+		/* Spend the idle time zeroing free pages, with interrupts
+		   on so that any thread that wakes up preempts us. */
+		intr_enable ();
+		while (palloc_prezero ())
+			continue;
+		intr_disable ();
+
 		/* Re-enable interrupts and wait for the next one.
 
 		   The `sti' instruction disables interrupts until the
@@ -416,16 +596,30 @@ kernel_thread (thread_func *function, void *aux) {
    NAME. */
 static void
 init_thread (struct thread *t, const char *name, int priority) {
+	enum intr_level old_level;
+
 	ASSERT (t != NULL);
 	ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
 	ASSERT (name != NULL);
 
 	memset (t, 0, sizeof *t);
 	t->status = THREAD_BLOCKED;
+	t->start_tsc = t->run_tsc = rdtsc ();
 	strlcpy (t->name, name, sizeof t->name);
 	t->tf.rsp = (uint64_t) t + PGSIZE - sizeof (void *);
 	t->priority = priority;
+	t->init_priority = priority;
+	list_init (&t->donations);
+#ifdef USERPROG
+	t->leader = t;
+	list_init (&t->uthreads);
+	lock_init (&t->uthread_lock);
+#endif
 	t->magic = THREAD_MAGIC;
+
+	old_level = intr_disable ();
+	list_push_back (&all_list, &t->allelem);
+	intr_set_level (old_level);
 }
 
 /* Chooses and returns the next thread to be scheduled.  Should
@@ -435,6 +629,9 @@ init_thread (struct thread *t, const char *name, int priority) {
    idle_thread. */
 static struct thread *
 next_thread_to_run (void) {
+	if (!list_empty (&edf_ready_list))
+		return list_entry (list_pop_front (&edf_ready_list),
+				struct thread, elem);
 	if (list_empty (&ready_list))
 		return idle_thread;
 	else
@@ -540,23 +737,21 @@ thread_launch (struct thread *th) {
 
 /* Schedules a new process. At entry, interrupts must be off.
  * This function modify current thread's status to status and then
- * finds another thread to run and switches to it.
+ * finds another thread to run and switches to it.  PREEMPTED says
+ * whether the switch is involuntary, for the statistics.
  * It's not safe to call printf() in the schedule(). */
 static void
-do_schedule(int status) {
+do_schedule(int status, bool preempted) {
 	ASSERT (intr_get_level () == INTR_OFF);
 	ASSERT (thread_current()->status == THREAD_RUNNING);
-	while (!list_empty (&destruction_req)) {
-		struct thread *victim =
-			list_entry (list_pop_front (&destruction_req), struct thread, elem);
-		palloc_free_page(victim);
-	}
+	if (destruction_cnt >= RECLAIM_BATCH)
+		reclaim_threads ();
 	thread_current ()->status = status;
-	schedule ();
+	schedule (preempted);
 }
 
 static void
-schedule (void) {
+schedule (bool preempted) {
 	struct thread *curr = running_thread ();
 	struct thread *next = next_thread_to_run ();
 
@@ -569,12 +764,30 @@ schedule (void) {
 	/* Start new time slice. */
 	thread_ticks = 0;
 
+	/* Make NEXT trap on its first FPU use unless its state is the
+	   one already loaded. */
+	fpu_switch (next);
+
 #ifdef USERPROG
 	/* Activate the new address space. */
 	process_activate (next);
 #endif
 
 	if (curr != next) {
+		uint64_t now = rdtsc ();
+
+		/* Account for the switch.  The idle thread is never in
+		   the ready queue, so its queueing latency means nothing. */
+		curr->run_cycles += now - curr->run_tsc;
+		if (preempted)
+			curr->involuntary_switches++;
+		else
+			curr->voluntary_switches++;
+		if (next != idle_thread)
+			schedstat_latency (next->woken, now - next->ready_tsc);
+		next->run_tsc = now;
+		schedstat_event (SCHED_SWITCH, curr->tid, next->tid);
+
 		/* If the thread we switched from is dying, destroy its struct
 		   thread. This must happen late so that thread_exit() doesn't
 		   pull out the rug under itself.
@@ -585,12 +798,83 @@ schedule (void) {
 		if (curr && curr->status == THREAD_DYING && curr != initial_thread) {
 			ASSERT (curr != next);
 			list_push_back (&destruction_req, &curr->elem);
+			destruction_cnt++;
 		}
 
 		/* Before switching the thread, we first save the information
-		 * of current running. */
-		thread_launch (next);
+		 * of current running.  Every switch happens here, in kernel
+		 * mode and at a function call, so the callee-saved registers
+		 * are all the state we have to keep; the full intr_frame is
+		 * only needed when thread_iret_switch asks for it. */
+		if (!thread_iret_switch) {
+			uint64_t ksp = next->ksp;
+
+			next->ksp = 0;
+			switch_threads (&curr->ksp, ksp, &next->tf);
+		} else {
+			if (next->ksp != 0) {
+				/* NEXT was suspended by switch_threads(); resume it
+				   by iretting into the tail of that routine. */
+				next->tf.rip = (uintptr_t) switch_threads_resume;
+				next->tf.rsp = next->ksp;
+				next->tf.ds = SEL_KDSEG;
+				next->tf.es = SEL_KDSEG;
+				next->tf.ss = SEL_KDSEG;
+				next->tf.cs = SEL_KCSEG;
+				next->tf.eflags = FLAG_MBS;
+				next->ksp = 0;
+			}
+			curr->ksp = 0;
+			thread_launch (next);
+		}
+	}
+}
+
+/* Returns a page for a new thread's struct thread and kernel
+   stack, or a null pointer if none is available.  Prefers a
+   cached page, then the page of a thread that died since the
+   last reclaim, and only then asks palloc.  The page is not
+   zeroed: init_thread() clears the struct thread, and nothing
+   depends on the contents of the stack. */
+static struct thread *
+alloc_thread_page (void) {
+	struct thread *t = NULL;
+	enum intr_level old_level;
+
+	old_level = intr_disable ();
+	if (!list_empty (&thread_cache)) {
+		t = list_entry (list_pop_front (&thread_cache), struct thread, elem);
+		thread_cache_cnt--;
+	} else if (!list_empty (&destruction_req)) {
+		t = list_entry (list_pop_front (&destruction_req), struct thread, elem);
+		destruction_cnt--;
+	}
+	intr_set_level (old_level);
+
+	if (t == NULL)
+		t = palloc_get_page (0);
+	return t;
+}
+
+/* Moves the pages of dead threads from destruction_req to the
+   thread cache, freeing those that do not fit.  Called from
+   do_schedule() once RECLAIM_BATCH threads are waiting, so that
+   their pages are handled together rather than one per switch.
+   Must be called with interrupts off. */
+static void
+reclaim_threads (void) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	while (!list_empty (&destruction_req)) {
+		struct list_elem *e = list_pop_front (&destruction_req);
+
+		if (thread_cache_cnt < THREAD_CACHE_MAX) {
+			list_push_back (&thread_cache, e);
+			thread_cache_cnt++;
+		} else
+			palloc_free_page (list_entry (e, struct thread, elem));
 	}
+	destruction_cnt = 0;
 }
 
 /* Returns a tid to use for a new thread. */
@@ -607,39 +891,338 @@ allocate_tid (void) {
 }
 
 /* project1 alarm clock */
+/* Returns true if the thread owning sleep list element A is due
+   to wake before the one owning B. */
+static bool
+compare_awake_time (const struct list_elem *a, const struct list_elem *b,
+		void *aux UNUSED) {
+	return list_entry (a, struct thread, elem)->awake_time
+		< list_entry (b, struct thread, elem)->awake_time;
+}
+
+/* Puts the current thread to sleep until the timer reaches
+   tick TICKS.  sleep_list is kept sorted by wakeup tick, so that
+   the timer interrupt only has to look at its front. */
 void thread_sleep(int64_t ticks){
 	enum intr_level old_level;
 	old_level = intr_disable ();
 	
 	struct thread *curr = thread_current();
 	curr->awake_time = ticks;
-	list_push_back(&sleep_list, &curr->elem);
+	list_insert_ordered (&sleep_list, &curr->elem, compare_awake_time, NULL);
 	thread_block();
 	intr_set_level (old_level);
 }
 
-void thread_awake(int64_t ticks){
+/* Wakes every thread whose wakeup tick is at or before TICKS. */
+static void
+wake_sleepers (int64_t ticks) {
 	enum intr_level old_level;
+
 	old_level = intr_disable ();
-	
+	while (!list_empty (&sleep_list)) {
+		struct thread *t = list_entry (list_front (&sleep_list),
+				struct thread, elem);
+		if (t->awake_time > ticks)
+			break;
+		list_pop_front (&sleep_list);
+		thread_unblock (t);
+	}
+	intr_set_level (old_level);
+	thread_preempt ();
+}
+
+/* Work item that runs wake_sleepers() in thread context. */
+static void
+wake_sleepers_work (void *aux UNUSED) {
+	wake_sleepers (timer_ticks ());
+}
+
+/* Called by the timer interrupt handler at tick TICKS.  Once the
+   system workqueues exist, the wakeups themselves are deferred to
+   the high-priority one, so that the handler does constant work
+   however many threads are due; the worker runs at PRI_MAX and
+   so still wakes them before the interrupted thread resumes. */
+void thread_awake(int64_t ticks){
+	static struct work wakeup_work;
 	struct thread *t;
-	struct list_elem *e;
 
-	for (e = list_begin(&sleep_list); e != list_end(&sleep_list);){
-		t = list_entry(e, struct thread, elem);
-		if (t->awake_time <= ticks){
-			e = list_remove(e);
-			thread_unblock(t);
-		}
-		else {
-			e = list_next(e);
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (list_empty (&sleep_list))
+		return;
+	t = list_entry (list_front (&sleep_list), struct thread, elem);
+	if (t->awake_time > ticks)
+		return;
+
+	if (system_highpri_wq != NULL) {
+		if (wakeup_work.func == NULL)
+			work_init (&wakeup_work, wake_sleepers_work, NULL);
+		schedule_work (system_highpri_wq, &wakeup_work);
+	} else
+		wake_sleepers (ticks);
+}
+
+/* project1 priority */
+/* Returns true if the thread owning ready or wait list element A
+   has a higher priority than the one owning B.  Ordering a list
+   with this function puts the highest priority first, and
+   equal-priority threads keep their insertion (FIFO) order. */
+bool
+compare_priority (const struct list_elem *a, const struct list_elem *b,
+		void *aux UNUSED) {
+	return list_entry (a, struct thread, elem)->priority
+		> list_entry (b, struct thread, elem)->priority;
+}
+
+/* Donates T's priority along the chain of locks it is blocked on:
+   the holder of T's lock, then the holder of the lock that thread
+   is blocked on, and so on, for at most DONATION_DEPTH links.
+   The walk stops at the first holder that already runs at T's
+   priority or higher, since everything beyond it does too, so a
+   donation costs O(depth) and usually much less.
+
+   Must be called with interrupts off. */
+void
+thread_donate_priority (struct thread *t) {
+	int depth;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	for (depth = 0; depth < DONATION_DEPTH && t->wait_on_lock != NULL;
+			depth++) {
+		struct thread *holder = t->wait_on_lock->holder;
+
+		if (holder == NULL || holder->priority >= t->priority)
+			break;
+		holder->priority = t->priority;
+
+		/* Keep the ready list sorted.  Semaphore waiters are not
+		   sorted, so a blocked holder needs no fixing up, and EDF
+		   threads are ordered by deadline, not priority. */
+		if (holder->status == THREAD_READY && !holder->edf) {
+			list_remove (&holder->elem);
+			list_insert_ordered (&ready_list, &holder->elem,
+					compare_priority, NULL);
 		}
+		t = holder;
 	}
+}
+
+/* Recomputes T's effective priority from its own priority and the
+   donations it still holds.  Called after T returns donations by
+   releasing a lock and after T's own priority changes.
+
+   Must be called with interrupts off. */
+void
+thread_refresh_priority (struct thread *t) {
+	struct list_elem *e;
 
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	t->priority = t->init_priority;
+	for (e = list_begin (&t->donations); e != list_end (&t->donations);
+			e = list_next (e)) {
+		struct thread *donor = list_entry (e, struct thread, donation_elem);
+		if (donor->priority > t->priority)
+			t->priority = donor->priority;
+	}
+}
+
+/* Yields the CPU if a ready thread outranks the running thread:
+   an EDF thread with an earlier deadline, or, if no EDF thread is
+   involved, a thread with a higher priority.  In an external
+   interrupt handler, the yield happens just before returning from
+   the interrupt. */
+void
+thread_preempt (void) {
+	enum intr_level old_level;
+	bool yield;
+
+	old_level = intr_disable ();
+	yield = ready_outranks_current ();
 	intr_set_level (old_level);
+
+	if (!yield)
+		return;
+	if (intr_context ())
+		intr_yield_on_return ();
+	else
+		thread_yield_preempted ();
 }
 
-/* project1 priority */
-bool compare_priority(struct list_elem *a, struct list_elem *b){
-	return list_entry(a, struct thread, elem)->priority > list_entry(b, struct thread, elem)->priority;
-}
\ No newline at end of file
+/* Returns true if the best ready thread should run instead of the
+   running thread.  Must be called with interrupts off. */
+static bool
+ready_outranks_current (void) {
+	struct thread *curr = thread_current ();
+
+	if (!list_empty (&edf_ready_list)) {
+		struct thread *t = list_entry (list_front (&edf_ready_list),
+				struct thread, elem);
+		return !curr->edf || t->edf_abs_deadline < curr->edf_abs_deadline;
+	}
+	if (curr->edf || list_empty (&ready_list))
+		return false;
+	return list_entry (list_front (&ready_list), struct thread, elem)->priority
+		> curr->priority;
+}
+
+/* Puts T, which is becoming ready, on the proper ready list. */
+static void
+ready_insert (struct thread *t) {
+	if (t->edf)
+		list_insert_ordered (&edf_ready_list, &t->elem, compare_deadline, NULL);
+	else
+		list_insert_ordered (&ready_list, &t->elem, compare_priority, NULL);
+}
+
+/* Returns true if the EDF thread owning list element A has an
+   earlier deadline than the one owning B. */
+static bool
+compare_deadline (const struct list_elem *a, const struct list_elem *b,
+		void *aux UNUSED) {
+	return list_entry (a, struct thread, elem)->edf_abs_deadline
+		< list_entry (b, struct thread, elem)->edf_abs_deadline;
+}
+
+/* Returns true if the EDF thread owning list element A is
+   released before the one owning B. */
+static bool
+compare_release (const struct list_elem *a, const struct list_elem *b,
+		void *aux UNUSED) {
+	return list_entry (a, struct thread, elem)->edf_release
+		< list_entry (b, struct thread, elem)->edf_release;
+}
+
+/* Returns the density, in thousandths rounded up, of a task that
+   needs RUNTIME ticks within DEADLINE ticks of each release.  With
+   deadlines no longer than periods, EDF meets every deadline if
+   the densities add up to at most 1; the utilization, RUNTIME over
+   the period, would admit task sets that miss deadlines. */
+static int
+edf_density (int64_t runtime, int64_t deadline) {
+	return (runtime * 1000 + deadline - 1) / deadline;
+}
+
+/* Moves the running thread into the EDF class: from now on it
+   runs for up to RUNTIME ticks in every PERIOD ticks, and each
+   job must be done within DEADLINE ticks of its release.  The
+   first period starts now.  Returns false, leaving the thread's
+   class alone, if the parameters are invalid, including a DEADLINE
+   beyond the PERIOD, or if admitting the thread would raise the
+   total density, RUNTIME / DEADLINE, above EDF_UTIL_MAX.
+   A RUNTIME of 0 returns the thread to the priority scheduler.
+
+   EDF threads run before all other threads, earliest deadline
+   first.  A thread that uses up its budget is throttled until
+   its next period, so a misbehaving EDF thread cannot starve
+   the rest of the system.  Each job should end with
+   thread_edf_yield(). */
+bool
+thread_set_edf (int64_t runtime, int64_t period, int64_t deadline) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+	int util, old_util;
+	int64_t now;
+
+	ASSERT (!intr_context ());
+
+	if (runtime < 0 || (runtime > 0 && (deadline < runtime || period < deadline)))
+		return false;
+
+	old_level = intr_disable ();
+	old_util = curr->edf ? edf_density (curr->edf_runtime,
+			curr->edf_deadline) : 0;
+	if (runtime == 0) {
+		edf_util -= old_util;
+		curr->edf = false;
+		intr_set_level (old_level);
+		thread_preempt ();
+		return true;
+	}
+
+	util = edf_density (runtime, deadline);
+	if (edf_util - old_util + util > EDF_UTIL_MAX) {
+		intr_set_level (old_level);
+		return false;
+	}
+	edf_util += util - old_util;
+
+	now = timer_ticks ();
+	curr->edf = true;
+	curr->edf_throttled = false;
+	curr->edf_runtime = runtime;
+	curr->edf_period = period;
+	curr->edf_deadline = deadline;
+	curr->edf_release = now;
+	edf_replenish (curr);
+	curr->edf_job_deadline = curr->edf_abs_deadline;
+	curr->edf_job_ticks = 0;
+	intr_set_level (old_level);
+
+	thread_preempt ();
+	return true;
+}
+
+/* Ends the running EDF thread's current job, counting a deadline
+   miss if it is late, and sleeps until the next period starts.
+   If that period has already started, the next job starts at
+   once. */
+void
+thread_edf_yield (void) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+	int64_t now;
+
+	ASSERT (!intr_context ());
+	ASSERT (curr->edf);
+
+	old_level = intr_disable ();
+	now = timer_ticks ();
+	curr->edf_jobs++;
+	if (now > curr->edf_job_deadline)
+		curr->edf_misses++;
+	curr->edf_job_ticks = 0;
+
+	if (curr->edf_release > now) {
+		list_insert_ordered (&edf_wait_list, &curr->elem, compare_release, NULL);
+		thread_block ();
+	} else
+		edf_replenish (curr);
+	curr->edf_job_deadline = curr->edf_abs_deadline;
+	intr_set_level (old_level);
+
+	thread_preempt ();
+}
+
+/* Starts T's next period: refills its budget and sets the
+   period's deadline. */
+static void
+edf_replenish (struct thread *t) {
+	t->edf_abs_deadline = t->edf_release + t->edf_deadline;
+	t->edf_budget = t->edf_runtime;
+	t->edf_release += t->edf_period;
+}
+
+/* Starts the periods of the EDF threads waiting for a release at
+   or before tick NOW.  Called from the timer interrupt. */
+static void
+edf_release (int64_t now) {
+	bool released = false;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	while (!list_empty (&edf_wait_list)) {
+		struct thread *t = list_entry (list_front (&edf_wait_list),
+				struct thread, elem);
+		if (t->edf_release > now)
+			break;
+		list_pop_front (&edf_wait_list);
+		edf_replenish (t);
+		thread_unblock (t);
+		released = true;
+	}
+	if (released)
+		thread_preempt ();
+}
@@ -0,0 +1,157 @@
+#include "threads/workqueue.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Workqueues.
+
+   A workqueue is a list of pending work items served by a small
+   pool of kernel threads that all run at the queue's priority.
+   schedule_work() only links the item in and ups a semaphore, so
+   it is cheap enough, and safe, to call from an interrupt
+   handler.  This lets a handler acknowledge its device and leave
+   the rest of its job, which may be long or may need to sleep,
+   to thread context with interrupts on.
+
+   An item is run at most once per schedule_work() call that
+   returns true; scheduling an item that is already pending does
+   nothing.  The pending flag is cleared just before the item
+   runs, so an item may reschedule itself. */
+
+struct workqueue {
+	const char *name;           /* Name, for worker thread names. */
+	struct list pending;        /* Queued struct works. */
+	struct semaphore items;     /* Number of items in PENDING. */
+	int running;                /* Number of items now running. */
+	struct wait_queue idle_wq;  /* Threads in workqueue_flush(). */
+};
+
+struct workqueue *system_wq;
+struct workqueue *system_highpri_wq;
+
+static void worker (void *wq_);
+
+/* Creates the shared workqueues.  Must be called after
+   thread_start(). */
+void
+workqueue_init (void) {
+	system_wq = workqueue_create ("events", PRI_DEFAULT, 2);
+	system_highpri_wq = workqueue_create ("events_hi", PRI_MAX, 1);
+	if (system_wq == NULL || system_highpri_wq == NULL)
+		PANIC ("workqueue_init: out of memory");
+}
+
+/* Creates a workqueue named NAME that is served by WORKER_CNT
+   threads running at PRIORITY.  Returns the new workqueue, or a
+   null pointer if memory is short.  Workqueues are never
+   destroyed. */
+struct workqueue *
+workqueue_create (const char *name, int priority, int worker_cnt) {
+	struct workqueue *wq;
+	int i;
+
+	ASSERT (name != NULL);
+	ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
+	ASSERT (worker_cnt > 0);
+
+	wq = malloc (sizeof *wq);
+	if (wq == NULL)
+		return NULL;
+	wq->name = name;
+	list_init (&wq->pending);
+	sema_init (&wq->items, 0);
+	wq->running = 0;
+	wait_queue_init (&wq->idle_wq);
+
+	for (i = 0; i < worker_cnt; i++) {
+		char thread_name[16];
+
+		snprintf (thread_name, sizeof thread_name, "%s/%d", name, i);
+		if (thread_create (thread_name, priority, worker, wq) == TID_ERROR)
+			PANIC ("workqueue_create: cannot start worker for %s", name);
+	}
+	return wq;
+}
+
+/* Waits until every item queued on WQ has been run, including
+   items queued while waiting. */
+void
+workqueue_flush (struct workqueue *wq) {
+	enum intr_level old_level;
+
+	ASSERT (wq != NULL);
+	ASSERT (!intr_context ());
+
+	old_level = intr_disable ();
+	while (!list_empty (&wq->pending) || wq->running > 0)
+		wait_queue_wait (&wq->idle_wq, 0);
+	intr_set_level (old_level);
+}
+
+/* Initializes W to call FUNC with AUX when run. */
+void
+work_init (struct work *w, work_func *func, void *aux) {
+	ASSERT (w != NULL);
+	ASSERT (func != NULL);
+
+	w->func = func;
+	w->aux = aux;
+	w->pending = false;
+}
+
+/* Queues W to run on WQ.  Returns true if W was queued, false
+   if it was already pending.
+
+   This function may be called from an interrupt handler. */
+bool
+schedule_work (struct workqueue *wq, struct work *w) {
+	enum intr_level old_level;
+
+	ASSERT (wq != NULL);
+	ASSERT (w != NULL);
+
+	old_level = intr_disable ();
+	if (w->pending) {
+		intr_set_level (old_level);
+		return false;
+	}
+	w->pending = true;
+	list_push_back (&wq->pending, &w->elem);
+	intr_set_level (old_level);
+
+	sema_up (&wq->items);
+	return true;
+}
+
+/* Worker thread: runs WQ's items one at a time, forever. */
+static void
+worker (void *wq_) {
+	struct workqueue *wq = wq_;
+
+	for (;;) {
+		enum intr_level old_level;
+		struct work *w;
+		bool idle;
+
+		sema_down (&wq->items);
+
+		old_level = intr_disable ();
+		w = list_entry (list_pop_front (&wq->pending), struct work, elem);
+		w->pending = false;
+		wq->running++;
+		intr_set_level (old_level);
+
+		w->func (w->aux);
+
+		old_level = intr_disable ();
+		wq->running--;
+		idle = list_empty (&wq->pending) && wq->running == 0;
+		intr_set_level (old_level);
+
+		if (idle)
+			wait_queue_wake_all (&wq->idle_wq);
+	}
+}
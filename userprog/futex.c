@@ -0,0 +1,114 @@
+#include "userprog/futex.h"
+#include <debug.h>
+#include <hash.h>
+#include <stdint.h>
+#include <syscall-nr.h>
+#include "threads/interrupt.h"
+#include "threads/mmu.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Fast user-space mutexes.
+
+   A futex is just an aligned int in user memory.  User code
+   manipulates it with atomic instructions and only enters the
+   kernel to sleep while it holds some agreed value (FUTEX_WAIT)
+   or to wake sleepers after changing it (FUTEX_WAKE).
+
+   Sleepers are keyed by the physical address of the int, so
+   threads that map the same page share a futex no matter at
+   which virtual address they see it.  Keys are hashed into a
+   fixed table of wait queues; unrelated futexes that land in
+   the same bucket share a queue but are told apart by key. */
+
+/* Number of hash buckets.  A power of 2. */
+#define FUTEX_BUCKETS 64
+
+static struct wait_queue futex_table[FUTEX_BUCKETS];
+
+static int *futex_translate (int *uaddr, uintptr_t *key);
+static struct wait_queue *futex_bucket (uintptr_t key);
+
+/* Initializes the futex hash table. */
+void
+futex_init (void) {
+	int i;
+
+	for (i = 0; i < FUTEX_BUCKETS; i++)
+		wait_queue_init (&futex_table[i]);
+}
+
+/* Performs futex operation OP on the user int at UADDR:
+
+   - FUTEX_WAIT: if *UADDR equals VAL, sleeps until a FUTEX_WAKE
+     on the same int and returns 0.  Otherwise returns -1 at once,
+     so that a wakeup sent between the caller's check and the
+     system call is never lost.
+
+   - FUTEX_WAKE: wakes up to VAL threads sleeping on UADDR and
+     returns how many were woken.
+
+   Returns -1 if UADDR is not a mapped, aligned user address or
+   OP is unknown. */
+int
+futex (int *uaddr, int op, int val) {
+	enum intr_level old_level;
+	uintptr_t key;
+	int *kaddr;
+
+	kaddr = futex_translate (uaddr, &key);
+	if (kaddr == NULL)
+		return -1;
+
+	switch (op) {
+		case FUTEX_WAIT:
+			/* With interrupts off, no other thread can change the
+			   value or send a wakeup between the check and the
+			   sleep. */
+			old_level = intr_disable ();
+			if (*kaddr != val) {
+				intr_set_level (old_level);
+				return -1;
+			}
+			wait_queue_wait (futex_bucket (key), key);
+			intr_set_level (old_level);
+			return 0;
+
+		case FUTEX_WAKE:
+			if (val <= 0)
+				return 0;
+			return wait_queue_wake_key (futex_bucket (key), key, val);
+
+		default:
+			return -1;
+	}
+}
+
+/* Checks that UADDR is an aligned int in the current process's
+   user memory.  If so, stores its physical address in *KEY and
+   returns its kernel virtual address; otherwise returns a null
+   pointer. */
+static int *
+futex_translate (int *uaddr, uintptr_t *key) {
+	struct thread *curr = thread_current ();
+	uint8_t *kpage;
+
+	if (uaddr == NULL || !is_user_vaddr (uaddr)
+			|| (uintptr_t) uaddr % sizeof *uaddr != 0
+			|| curr->pml4 == NULL)
+		return NULL;
+
+	kpage = pml4_get_page (curr->pml4, pg_round_down (uaddr));
+	if (kpage == NULL)
+		return NULL;
+
+	*key = vtop (kpage) + pg_ofs (uaddr);
+	return (int *) (kpage + pg_ofs (uaddr));
+}
+
+/* Returns the wait queue for futexes with KEY. */
+static struct wait_queue *
+futex_bucket (uintptr_t key) {
+	return &futex_table[hash_bytes (&key, sizeof key) & (FUTEX_BUCKETS - 1)];
+}
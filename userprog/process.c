@@ -7,10 +7,12 @@
 #include <string.h>
 #include "userprog/gdt.h"
 #include "userprog/tss.h"
+#include "userprog/uthread.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "threads/flags.h"
+#include "threads/fpu.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
 #include "threads/palloc.h"
@@ -136,12 +138,14 @@ __do_fork (void *aux) {
 	process_activate (current);
 #ifdef VM
 	supplemental_page_table_init (&current->spt);
-	if (!supplemental_page_table_copy (&current->spt, &parent->spt))
+	if (!supplemental_page_table_copy (&current->spt, &parent->leader->spt))
 		goto error;
 #else
 	if (!pml4_for_each (parent->pml4, duplicate_pte, parent))
 		goto error;
 #endif
+	if (!fpu_fork (current, parent))
+		goto error;
 
 	/* TODO: Your code goes here.
 	 * TODO: Hint) To duplicate the file object, use `file_duplicate`
@@ -173,7 +177,14 @@ process_exec (void *f_name) {
 	_if.cs = SEL_UCSEG;
 	_if.eflags = FLAG_IF | FLAG_MBS;
 
+	/* Threads other than the main one do not own the address space. */
+	if (thread_current ()->uthread != NULL) {
+		palloc_free_page (file_name);
+		return -1;
+	}
+
 	/* We first kill the current context */
+	uthread_join_all ();
 	process_cleanup ();
 
 	/* And then load the binary */
@@ -216,6 +227,13 @@ process_exit (void) {
 	 * TODO: project2/process_termination.html).
 	 * TODO: We recommend you to implement process resource cleanup here. */
 
+	/* Threads made by uthread_create() share the main thread's
+	 * address space, which it destroys once they are all gone. */
+	if (curr->uthread != NULL) {
+		uthread_finish ();
+		return;
+	}
+	uthread_join_all ();
 	process_cleanup ();
 }
 
@@ -227,6 +245,7 @@ process_cleanup (void) {
 #ifdef VM
 	supplemental_page_table_kill (&curr->spt);
 #endif
+	fpu_release (curr);
 
 	uint64_t *pml4;
 	/* Destroy the current process's page directory and switch back
@@ -4,7 +4,9 @@
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "threads/loader.h"
+#include "userprog/futex.h"
 #include "userprog/gdt.h"
+#include "userprog/uthread.h"
 #include "threads/flags.h"
 #include "intrinsic.h"
 
@@ -35,11 +37,27 @@ syscall_init (void) {
 	 * mode stack. Therefore, we masked the FLAG_FL. */
 	write_msr(MSR_SYSCALL_MASK,
 			FLAG_IF | FLAG_TF | FLAG_DF | FLAG_IOPL | FLAG_AC | FLAG_NT);
+
+	futex_init ();
 }
 
 /* The main system call interface */
 void
-syscall_handler (struct intr_frame *f UNUSED) {
+syscall_handler (struct intr_frame *f) {
+	switch (f->R.rax) {
+		case SYS_FUTEX:
+			f->R.rax = futex ((int *) f->R.rdi, (int) f->R.rsi, (int) f->R.rdx);
+			return;
+		case SYS_THREAD_CREATE:
+			f->R.rax = uthread_create (f->R.rdi, f->R.rsi, f->R.rdx);
+			return;
+		case SYS_THREAD_JOIN:
+			f->R.rax = uthread_join ((tid_t) f->R.rdi);
+			return;
+		case SYS_THREAD_EXIT:
+			uthread_exit ((int) f->R.rdi);
+	}
+
 	// TODO: Your implementation goes here.
 	printf ("system call!\n");
 	thread_exit ();
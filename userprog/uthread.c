@@ -0,0 +1,328 @@
+#include "userprog/uthread.h"
+#include <debug.h>
+#include <list.h>
+#include <string.h>
+#include "userprog/gdt.h"
+#include "userprog/process.h"
+#include "threads/flags.h"
+#include "threads/fpu.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include "vm/vm.h"
+#endif
+
+/* Multithreaded user processes.
+
+   A process starts with a single kernel thread, its main thread,
+   which owns the page table, the supplemental page table and
+   everything else process-wide.  uthread_create() adds kernel
+   threads that run in the same address space: they point their
+   `pml4' at the main thread's and reach the rest through their
+   `leader'.  Nothing is copied.
+
+   Each extra thread gets its own user stack in a fixed slot below
+   the main thread's stack and a join record that outlives it, so
+   that uthread_join() can collect its exit status and unmap its
+   stack after it is gone.  The main thread joins every remaining
+   thread before it tears the address space down, on exit or
+   exec. */
+
+/* Room left for the main thread's stack below USER_STACK. */
+#define MAIN_STACK_SIZE (1 << 20)
+
+/* Address space reserved for each thread's stack.  With VM, the
+   slot is one anonymous region whose pages are faulted in as the
+   stack grows; without it, the whole slot is mapped up front. */
+#define UTHREAD_STACK_SIZE (64 * 1024)
+
+/* Maximum number of extra threads alive in one process, one per
+   bit of struct thread's `stack_slots'. */
+#define UTHREAD_MAX 64
+
+/* Join record for a thread created by uthread_create().  Owned by
+   the process's main thread, on its `uthreads' list. */
+struct uthread {
+	struct list_elem elem;              /* Element in leader's uthreads. */
+	struct thread *leader;              /* Main thread of the process. */
+	tid_t tid;                          /* Thread identifier. */
+	int status;                         /* Exit status; -1 if killed. */
+	int slot;                           /* User stack slot. */
+	bool joining;                       /* Someone is joining it. */
+	struct semaphore exited;            /* Upped when the thread exits. */
+
+	/* Initial user context. */
+	uintptr_t rip;                      /* Entry point. */
+	uint64_t arg0, arg1;                /* Passed in rdi and rsi. */
+};
+
+static void start_uthread (void *);
+static uint8_t *stack_top (int slot);
+static bool map_stack (struct thread *leader, int slot);
+static void unmap_stack (struct thread *leader, int slot);
+static void reap (struct thread *leader, struct uthread *);
+
+/* Starts a new thread in the current process that calls the user
+   function at RIP with ARG0 and ARG1 as its first two arguments,
+   on a fresh user stack.  The function must not return; user
+   code wraps it in a routine that calls uthread_exit().
+
+   Returns the new thread's tid, or TID_ERROR if RIP is not a user
+   address or resources ran out. */
+tid_t
+uthread_create (uintptr_t rip, uint64_t arg0, uint64_t arg1) {
+	struct thread *curr = thread_current ();
+	struct thread *leader = curr->leader;
+	struct uthread *ut;
+	tid_t tid;
+	int slot;
+
+	if (curr->pml4 == NULL || !is_user_vaddr (rip))
+		return TID_ERROR;
+
+	ut = malloc (sizeof *ut);
+	if (ut == NULL)
+		return TID_ERROR;
+	ut->leader = leader;
+	ut->tid = TID_ERROR;
+	ut->status = -1;
+	ut->joining = false;
+	sema_init (&ut->exited, 0);
+	ut->rip = rip;
+	ut->arg0 = arg0;
+	ut->arg1 = arg1;
+
+	/* Claim a stack slot. */
+	lock_acquire (&leader->uthread_lock);
+	for (slot = 0; slot < UTHREAD_MAX; slot++)
+		if (!(leader->stack_slots & (1ULL << slot)))
+			break;
+	if (slot == UTHREAD_MAX) {
+		lock_release (&leader->uthread_lock);
+		free (ut);
+		return TID_ERROR;
+	}
+	leader->stack_slots |= 1ULL << slot;
+	ut->slot = slot;
+	list_push_back (&leader->uthreads, &ut->elem);
+	lock_release (&leader->uthread_lock);
+
+	if (!map_stack (leader, slot)) {
+		reap (leader, ut);
+		return TID_ERROR;
+	}
+
+	tid = thread_create (curr->name, thread_get_priority (), start_uthread, ut);
+	if (tid == TID_ERROR) {
+		reap (leader, ut);
+		return TID_ERROR;
+	}
+
+	lock_acquire (&leader->uthread_lock);
+	ut->tid = tid;
+	lock_release (&leader->uthread_lock);
+	return tid;
+}
+
+/* Waits for thread TID of the current process to exit, releases
+   its stack and returns its exit status.  Returns -1 at once if
+   TID is not a joinable thread of this process, which includes
+   the main thread, the caller itself and threads that someone
+   else is already joining. */
+int
+uthread_join (tid_t tid) {
+	struct thread *curr = thread_current ();
+	struct thread *leader = curr->leader;
+	struct uthread *ut = NULL;
+	struct list_elem *e;
+	int status;
+
+	lock_acquire (&leader->uthread_lock);
+	for (e = list_begin (&leader->uthreads); e != list_end (&leader->uthreads);
+			e = list_next (e)) {
+		struct uthread *u = list_entry (e, struct uthread, elem);
+		if (u->tid == tid && tid != TID_ERROR && !u->joining
+				&& u != curr->uthread) {
+			ut = u;
+			ut->joining = true;
+			break;
+		}
+	}
+	lock_release (&leader->uthread_lock);
+	if (ut == NULL)
+		return -1;
+
+	sema_down (&ut->exited);
+	status = ut->status;
+	reap (leader, ut);
+	return status;
+}
+
+/* Terminates the current thread with exit status STATUS.  In the
+   main thread this ends the whole process, after joining the
+   others. */
+void
+uthread_exit (int status) {
+	struct thread *curr = thread_current ();
+
+	if (curr->uthread != NULL)
+		curr->uthread->status = status;
+	thread_exit ();
+}
+
+/* Called by process_exit() in a thread made by uthread_create().
+   Detaches the thread from the address space, which belongs to
+   the main thread, and wakes its joiner. */
+void
+uthread_finish (void) {
+	struct thread *curr = thread_current ();
+
+	ASSERT (curr->uthread != NULL);
+
+	fpu_release (curr);
+	curr->pml4 = NULL;
+	pml4_activate (NULL);
+	sema_up (&curr->uthread->exited);
+}
+
+/* Called in a process's main thread before the address space is
+   destroyed.  Waits for every thread made by uthread_create() that
+   nobody else is joining to exit, and reaps it. */
+void
+uthread_join_all (void) {
+	struct thread *curr = thread_current ();
+
+	ASSERT (curr->leader == curr);
+
+	for (;;) {
+		struct uthread *ut = NULL;
+		struct list_elem *e;
+
+		lock_acquire (&curr->uthread_lock);
+		for (e = list_begin (&curr->uthreads); e != list_end (&curr->uthreads);
+				e = list_next (e)) {
+			struct uthread *u = list_entry (e, struct uthread, elem);
+			if (!u->joining) {
+				ut = u;
+				ut->joining = true;
+				break;
+			}
+		}
+		lock_release (&curr->uthread_lock);
+		if (ut == NULL)
+			break;
+
+		sema_down (&ut->exited);
+		reap (curr, ut);
+	}
+}
+
+/* Thread function for a new user thread: adopts the process's
+   address space and enters user mode. */
+static void
+start_uthread (void *ut_) {
+	struct uthread *ut = ut_;
+	struct thread *curr = thread_current ();
+	struct intr_frame if_;
+
+	/* The main thread cannot tear the address space down before
+	   we run, because it joins us first. */
+	curr->leader = ut->leader;
+	curr->uthread = ut;
+	curr->pml4 = ut->leader->pml4;
+	process_activate (curr);
+
+	memset (&if_, 0, sizeof if_);
+	if_.rip = ut->rip;
+	if_.R.rdi = ut->arg0;
+	if_.R.rsi = ut->arg1;
+	/* As if the entry point had just been called. */
+	if_.rsp = (uintptr_t) stack_top (ut->slot) - sizeof (void *);
+	if_.ds = if_.es = if_.ss = SEL_UDSEG;
+	if_.cs = SEL_UCSEG;
+	if_.eflags = FLAG_IF | FLAG_MBS;
+	do_iret (&if_);
+	NOT_REACHED ();
+}
+
+/* Returns the top of the user stack in SLOT. */
+static uint8_t *
+stack_top (int slot) {
+	return (uint8_t *) USER_STACK - MAIN_STACK_SIZE - slot * UTHREAD_STACK_SIZE;
+}
+
+/* Maps the stack in SLOT, zeroed, into LEADER's address space,
+   which must be the current thread's.  Returns true if
+   successful. */
+static bool
+map_stack (struct thread *leader, int slot) {
+	uint8_t *bottom = stack_top (slot) - UTHREAD_STACK_SIZE;
+#ifdef VM
+	ASSERT (leader == thread_current ()->leader);
+
+	/* Fault in the top page now; the rest follow on demand. */
+	return vm_alloc_region (VM_ANON | VM_MARKER_0, bottom,
+			UTHREAD_STACK_SIZE / PGSIZE, true, NULL, NULL)
+		&& vm_claim_page (stack_top (slot) - PGSIZE);
+#else
+	uint8_t *upage;
+
+	for (upage = bottom; upage < stack_top (slot); upage += PGSIZE) {
+		uint8_t *kpage = palloc_get_page (PAL_USER | PAL_ZERO);
+
+		if (kpage == NULL)
+			goto fail;
+		if (pml4_get_page (leader->pml4, upage) != NULL
+				|| !pml4_set_page (leader->pml4, upage, kpage, true)) {
+			palloc_free_page (kpage);
+			goto fail;
+		}
+	}
+	return true;
+
+fail:
+	unmap_stack (leader, slot);
+	return false;
+#endif
+}
+
+/* Unmaps the stack in SLOT from LEADER's address space. */
+static void
+unmap_stack (struct thread *leader, int slot) {
+#ifdef VM
+	struct vma *vma = spt_find_vma (&leader->spt,
+			stack_top (slot) - PGSIZE);
+
+	if (vma != NULL)
+		spt_remove_vma (&leader->spt, vma);
+#else
+	uint8_t *upage;
+
+	for (upage = stack_top (slot) - UTHREAD_STACK_SIZE;
+			upage < stack_top (slot); upage += PGSIZE) {
+		void *kpage = pml4_get_page (leader->pml4, upage);
+
+		if (kpage != NULL) {
+			pml4_clear_page (leader->pml4, upage);
+			palloc_free_page (kpage);
+		}
+	}
+#endif
+}
+
+/* Removes UT from LEADER's records, frees its stack slot and
+   frees UT.  UT's thread must have exited or never started. */
+static void
+reap (struct thread *leader, struct uthread *ut) {
+	unmap_stack (leader, ut->slot);
+
+	lock_acquire (&leader->uthread_lock);
+	list_remove (&ut->elem);
+	leader->stack_slots &= ~(1ULL << ut->slot);
+	lock_release (&leader->uthread_lock);
+
+	free (ut);
+}
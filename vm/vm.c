@@ -1,9 +1,17 @@
 /* vm.c: Generic interface for virtual memory objects. */
 
+#include <string.h>
 #include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/slab.h"
+#include "threads/vaddr.h"
 #include "vm/vm.h"
 #include "vm/inspect.h"
 
+struct kmem_cache *page_cache;
+struct kmem_cache *frame_cache;
+
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
 void
@@ -16,6 +24,10 @@ vm_init (void) {
 	register_inspect_intr ();
 	/* DO NOT MODIFY UPPER LINES. */
 	/* TODO: Your code goes here. */
+	page_cache = kmem_cache_create ("page", sizeof (struct page), 0, NULL);
+	frame_cache = kmem_cache_create ("frame", sizeof (struct frame), 0, NULL);
+	if (page_cache == NULL || frame_cache == NULL)
+		PANIC ("vm object cache creation failed");
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -36,6 +48,12 @@ page_get_type (struct page *page) {
 static struct frame *vm_get_victim (void);
 static bool vm_do_claim_page (struct page *page);
 static struct frame *vm_evict_frame (void);
+static struct page *new_page (struct supplemental_page_table *spt,
+		enum vm_type type, void *upage, bool writable,
+		vm_initializer *init, void *aux);
+static struct page *find_page (struct supplemental_page_table *spt,
+		void *va);
+static struct vma *find_vma (struct supplemental_page_table *spt, void *va);
 
 /* Create the pending page object with initializer. If you want to create a
  * page, do not create it directly and make it through this function or
@@ -46,43 +64,411 @@ vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable,
 
 	ASSERT (VM_TYPE(type) != VM_UNINIT)
 
-	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct supplemental_page_table *spt = &thread_current ()->leader->spt;
+	bool success = false;
 
 	/* Check wheter the upage is already occupied or not. */
-	if (spt_find_page (spt, upage) == NULL) {
-		/* TODO: Create the page, fetch the initialier according to the VM type,
-		 * TODO: and then create "uninit" page struct by calling uninit_new. You
-		 * TODO: should modify the field after calling the uninit_new. */
+	lock_acquire (&spt->lock);
+	if (find_page (spt, upage) == NULL
+			&& new_page (spt, type, upage, writable, init, aux) != NULL)
+		success = true;
+	lock_release (&spt->lock);
+	return success;
+}
+
+/* Maps the PAGE_CNT pages starting at UPAGE as one region of
+ * pages of TYPE, each initialized by INIT with AUX when first
+ * faulted in.  Records a single VMA, however large the region.
+ * Fails if any of the pages is already in use.  All the pages
+ * share AUX, which INIT must not modify or free; see
+ * vm_initializer. */
+bool
+vm_alloc_region (enum vm_type type, void *upage, size_t page_cnt,
+		bool writable, vm_initializer *init, void *aux) {
+	struct supplemental_page_table *spt = &thread_current ()->leader->spt;
+	struct vma *vma;
+
+	ASSERT (VM_TYPE (type) != VM_UNINIT);
+	ASSERT (pg_ofs (upage) == 0);
+
+	if (page_cnt == 0 || !is_user_vaddr (upage)
+			|| page_cnt > (KERN_BASE - (uint64_t) upage) / PGSIZE)
+		return false;
+
+	vma = malloc (sizeof *vma);
+	if (vma == NULL)
+		return false;
+	*vma = (struct vma) {
+		.start = upage,
+		.end = (uint8_t *) upage + page_cnt * PGSIZE,
+		.type = type,
+		.writable = writable,
+		.init = init,
+		.aux = aux,
+	};
+	if (!spt_insert_vma (spt, vma)) {
+		free (vma);
+		return false;
+	}
+	return true;
+}
+
+/* Creates an uninit page of TYPE for UPAGE in SPT, whose lock
+ * must be held.  Returns the page, or a null pointer if memory is
+ * short or UPAGE already has a page. */
+static struct page *
+new_page (struct supplemental_page_table *spt, enum vm_type type,
+		void *upage, bool writable, vm_initializer *init, void *aux) {
+	bool (*initializer) (struct page *, enum vm_type, void *);
+	struct page *page;
+
+	switch (VM_TYPE (type)) {
+		case VM_ANON:
+			initializer = anon_initializer;
+			break;
+		case VM_FILE:
+			initializer = file_backed_initializer;
+			break;
+		default:
+			return NULL;
+	}
+
+	page = kmem_cache_alloc (page_cache);
+	if (page == NULL)
+		return NULL;
+	uninit_new (page, upage, init, type, aux, initializer);
+	page->writable = writable;
+	if (hash_insert (&spt->pages, &page->spt_elem) != NULL) {
+		kmem_cache_free (page_cache, page);
+		return NULL;
+	}
+	return page;
+}
+
+/* A page mapped with vm_map_huge_page() has a single `struct page'
+ * for the whole LARGE_PAGE_SIZE bytes, at their first address,
+ * with these operations.  Its frame records the large page's
+ * kernel address; the memory itself is freed along with the page
+ * table.  Before any part of it is swapped out, split_large_page()
+ * must replace it by 4 kB pages. */
+static bool large_swap_in (struct page *page, void *kva);
+static bool large_swap_out (struct page *page);
+static void large_destroy (struct page *page);
+
+static const struct page_operations large_ops = {
+	.swap_in = large_swap_in,
+	.swap_out = large_swap_out,
+	.destroy = large_destroy,
+	.type = VM_ANON,
+};
+
+/* Returns true if PAGE stands for a large page. */
+static bool
+is_large_page (const struct page *page) {
+	return page->operations == &large_ops;
+}
+
+/* A large page is never swapped out, so it is never swapped in
+ * either. */
+static bool
+large_swap_in (struct page *page UNUSED, void *kva UNUSED) {
+	return false;
+}
+
+/* Refuses to swap out a large page as a whole.  Evicting part of
+ * it takes split_large_page() first. */
+static bool
+large_swap_out (struct page *page UNUSED) {
+	return false;
+}
+
+/* Frees the frame record of large page PAGE. */
+static void
+large_destroy (struct page *page) {
+	kmem_cache_free (frame_cache, page->frame);
+}
+
+/* Backs the LARGE_PAGE_SIZE bytes at UPAGE, none of which may have
+ * a `struct page' yet, with a zeroed large page, and records it in
+ * SPT, whose lock must be held.  Returns the new page, or a null pointer if no large page is
+ * available. */
+static struct page *
+map_large_page (struct supplemental_page_table *spt, void *upage,
+		bool writable) {
+	struct frame *frame;
+	struct page *page;
+
+	frame = kmem_cache_alloc (frame_cache);
+	if (frame == NULL)
+		return NULL;
+	page = new_page (spt, VM_ANON, upage, writable, NULL, NULL);
+	if (page == NULL) {
+		kmem_cache_free (frame_cache, frame);
+		return NULL;
+	}
+	if (!vm_map_huge_page (upage, writable)) {
+		hash_delete (&spt->pages, &page->spt_elem);
+		kmem_cache_free (page_cache, page);
+		kmem_cache_free (frame_cache, frame);
+		return NULL;
+	}
+
+	frame->kva = pml4_get_page (thread_current ()->leader->pml4, upage);
+	frame->page = page;
+	page->frame = frame;
+	page->operations = &large_ops;
+	return page;
+}
 
-		/* TODO: Insert the page into the spt. */
+/* Replaces large page LARGE in SPT, whose lock must be held, by
+ * LARGE_PAGE_SIZE / PGSIZE anonymous pages, each owning its 4 kB
+ * of LARGE's memory, and splits the mapping to match.  A 4 kB
+ * piece whose mapping was cleared, e.g. by pml4_clear_page(), is
+ * mapped again, since its memory is still LARGE's.  Returns false
+ * if memory is short, leaving LARGE in SPT. */
+static bool
+split_large_page (struct supplemental_page_table *spt, struct page *large) {
+	uint64_t *pml4 = thread_current ()->leader->pml4;
+	uint8_t *kva = large->frame->kva;
+	size_t ofs;
+
+	if (!pml4_split_page (pml4, large->va))
+		return false;
+
+	hash_delete (&spt->pages, &large->spt_elem);
+	for (ofs = 0; ofs < LARGE_PAGE_SIZE; ofs += PGSIZE) {
+		void *upage = (uint8_t *) large->va + ofs;
+		struct frame *frame;
+		struct page *page;
+
+		frame = kmem_cache_alloc (frame_cache);
+		if (frame == NULL)
+			goto fail;
+		page = new_page (spt, VM_ANON, upage, large->writable, NULL, NULL);
+		if (page == NULL) {
+			kmem_cache_free (frame_cache, frame);
+			goto fail;
+		}
+		frame->kva = kva + ofs;
+		frame->page = page;
+		page->frame = frame;
+		if (!swap_in (page, frame->kva)
+				|| (pml4_get_page (pml4, upage) == NULL
+					&& !pml4_set_page (pml4, upage, frame->kva, large->writable))) {
+			ofs += PGSIZE;
+			goto fail;
+		}
 	}
-err:
+	vm_dealloc_page (large);
+	return true;
+
+fail:
+	/* Drop the 4 kB pages made so far.  Their memory stays
+	 * LARGE's. */
+	while (ofs > 0) {
+		struct page key;
+		struct page *page;
+
+		ofs -= PGSIZE;
+		key.va = (uint8_t *) large->va + ofs;
+		page = hash_entry (hash_delete (&spt->pages, &key.spt_elem),
+				struct page, spt_elem);
+		kmem_cache_free (frame_cache, page->frame);
+		kmem_cache_free (page_cache, page);
+	}
+	hash_insert (&spt->pages, &large->spt_elem);
 	return false;
 }
 
-/* Find VA from spt and return page. On error, return NULL. */
+/* Returns a hash value for the page in E. */
+static uint64_t
+page_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct page *page = hash_entry (e, struct page, spt_elem);
+
+	return hash_bytes (&page->va, sizeof page->va);
+}
+
+/* Returns true if page A precedes page B. */
+static bool
+page_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return hash_entry (a, struct page, spt_elem)->va
+		< hash_entry (b, struct page, spt_elem)->va;
+}
+
+/* Returns true if VMA A starts before VMA B. */
+static bool
+vma_less (const struct tree_elem *a, const struct tree_elem *b,
+		void *aux UNUSED) {
+	return tree_entry (a, struct vma, elem)->start
+		< tree_entry (b, struct vma, elem)->start;
+}
+
+/* Find VA from spt and return page. On error, return NULL.
+ * A page in a VMA gets its `struct page' here, the first time it
+ * is looked up. */
 struct page *
-spt_find_page (struct supplemental_page_table *spt UNUSED, void *va UNUSED) {
-	struct page *page = NULL;
-	/* TODO: Fill this function. */
+spt_find_page (struct supplemental_page_table *spt, void *va) {
+	struct page *page;
 
+	lock_acquire (&spt->lock);
+	page = find_page (spt, va);
+	lock_release (&spt->lock);
 	return page;
 }
 
+/* Does the work of spt_find_page() for a caller that holds SPT's
+ * lock. */
+static struct page *
+find_page (struct supplemental_page_table *spt, void *va) {
+	struct page key = { .va = pg_round_down (va) };
+	struct hash_elem *e;
+	struct vma *vma;
+
+	e = hash_find (&spt->pages, &key.spt_elem);
+	if (e != NULL)
+		return hash_entry (e, struct page, spt_elem);
+
+	vma = find_vma (spt, key.va);
+	if (vma == NULL)
+		return NULL;
+
+	/* The page may be part of a large page. */
+	if (VM_TYPE (vma->type) == VM_ANON) {
+		struct page large = {
+			.va = (void *) ((uint64_t) key.va & ~(LARGE_PAGE_SIZE - 1)),
+		};
+
+		e = hash_find (&spt->pages, &large.spt_elem);
+		if (e != NULL && is_large_page (hash_entry (e, struct page, spt_elem)))
+			return hash_entry (e, struct page, spt_elem);
+	}
+	return new_page (spt, vma->type, key.va, vma->writable, vma->init,
+			vma->aux);
+}
+
 /* Insert PAGE into spt with validation. */
 bool
-spt_insert_page (struct supplemental_page_table *spt UNUSED,
-		struct page *page UNUSED) {
-	int succ = false;
-	/* TODO: Fill this function. */
+spt_insert_page (struct supplemental_page_table *spt, struct page *page) {
+	bool success;
+
+	ASSERT (pg_ofs (page->va) == 0);
 
-	return succ;
+	lock_acquire (&spt->lock);
+	success = hash_insert (&spt->pages, &page->spt_elem) == NULL;
+	lock_release (&spt->lock);
+	return success;
 }
 
+/* Removes PAGE from SPT and frees it.  If PAGE lies in a VMA, it
+ * will get a fresh `struct page' when next looked up. */
 void
 spt_remove_page (struct supplemental_page_table *spt, struct page *page) {
+	lock_acquire (&spt->lock);
+	hash_delete (&spt->pages, &page->spt_elem);
+	lock_release (&spt->lock);
 	vm_dealloc_page (page);
-	return true;
+}
+
+/* Returns the VMA in SPT that contains VA, or a null pointer if
+ * there is none. */
+struct vma *
+spt_find_vma (struct supplemental_page_table *spt, void *va) {
+	struct vma *vma;
+
+	lock_acquire (&spt->lock);
+	vma = find_vma (spt, va);
+	lock_release (&spt->lock);
+	return vma;
+}
+
+/* Does the work of spt_find_vma() for a caller that holds SPT's
+ * lock. */
+static struct vma *
+find_vma (struct supplemental_page_table *spt, void *va) {
+	struct vma key = { .start = va };
+	struct tree_elem *e;
+	struct vma *vma;
+
+	e = tree_floor (&spt->vmas, &key.elem);
+	if (e == NULL)
+		return NULL;
+	vma = tree_entry (e, struct vma, elem);
+	return va < vma->end ? vma : NULL;
+}
+
+/* Returns true if a page in [START, END) has a `struct page' in
+ * SPT, whose lock must be held.  Looks up each address or scans the whole table, whichever
+ * is fewer steps. */
+static bool
+range_has_page (struct supplemental_page_table *spt, void *start, void *end) {
+	size_t page_cnt = ((uint8_t *) end - (uint8_t *) start) / PGSIZE;
+
+	if (page_cnt <= hash_size (&spt->pages)) {
+		struct page key;
+
+		for (key.va = start; key.va < end; key.va = (uint8_t *) key.va + PGSIZE)
+			if (hash_find (&spt->pages, &key.spt_elem) != NULL)
+				return true;
+	} else {
+		struct hash_iterator i;
+
+		hash_first (&i, &spt->pages);
+		while (hash_next (&i)) {
+			struct page *page = hash_entry (hash_cur (&i), struct page, spt_elem);
+
+			if (page->va >= start && page->va < end)
+				return true;
+		}
+	}
+	return false;
+}
+
+/* Inserts VMA, which must be allocated with malloc(), into SPT,
+ * which then owns it.  Fails if VMA overlaps another VMA or a
+ * page that already has a `struct page'. */
+bool
+spt_insert_vma (struct supplemental_page_table *spt, struct vma *vma) {
+	struct vma key = { .start = (uint8_t *) vma->end - 1 };
+	struct tree_elem *e;
+	bool success = false;
+
+	ASSERT (pg_ofs (vma->start) == 0);
+	ASSERT (pg_ofs (vma->end) == 0);
+	ASSERT (vma->start < vma->end);
+
+	/* Only the last VMA that starts before VMA ends can overlap
+	 * it. */
+	lock_acquire (&spt->lock);
+	e = tree_floor (&spt->vmas, &key.elem);
+	if ((e == NULL || tree_entry (e, struct vma, elem)->end <= vma->start)
+			&& !range_has_page (spt, vma->start, vma->end)) {
+		tree_insert (&spt->vmas, &vma->elem);
+		success = true;
+	}
+	lock_release (&spt->lock);
+	return success;
+}
+
+/* Removes VMA from SPT, frees the `struct page's of its pages,
+ * and frees VMA. */
+void
+spt_remove_vma (struct supplemental_page_table *spt, struct vma *vma) {
+	struct page key;
+
+	lock_acquire (&spt->lock);
+	tree_remove (&spt->vmas, &vma->elem);
+	for (key.va = vma->start; key.va < vma->end;
+			key.va = (uint8_t *) key.va + PGSIZE) {
+		struct hash_elem *e = hash_find (&spt->pages, &key.spt_elem);
+
+		if (e != NULL) {
+			hash_delete (&spt->pages, e);
+			vm_dealloc_page (hash_entry (e, struct page, spt_elem));
+		}
+	}
+	lock_release (&spt->lock);
+	free (vma);
 }
 
 /* Get the struct frame, that will be evicted. */
@@ -128,18 +514,87 @@ static bool
 vm_handle_wp (struct page *page UNUSED) {
 }
 
+/* Backs the aligned LARGE_PAGE_SIZE bytes around ADDR with a large
+ * page, if they lie in a single anonymous, zero-filled VMA and no
+ * page among them has been looked up yet.  Returns false if not, in
+ * which case the fault is handled with 4 kB pages. */
+static bool
+try_large_page (struct supplemental_page_table *spt, void *addr,
+		bool write) {
+	void *base = (void *) ((uint64_t) addr & ~(LARGE_PAGE_SIZE - 1));
+	void *end = (uint8_t *) base + LARGE_PAGE_SIZE;
+	struct vma *vma;
+	bool success = false;
+
+	lock_acquire (&spt->lock);
+	vma = find_vma (spt, addr);
+	if (vma != NULL && VM_TYPE (vma->type) == VM_ANON && vma->init == NULL
+			&& (!write || vma->writable)
+			&& base >= vma->start && end <= vma->end
+			&& !range_has_page (spt, base, end))
+		success = map_large_page (spt, base, vma->writable) != NULL;
+	lock_release (&spt->lock);
+	return success;
+}
+
 /* Return true on success */
 bool
-vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
-		bool user UNUSED, bool write UNUSED, bool not_present UNUSED) {
-	struct supplemental_page_table *spt UNUSED = &thread_current ()->spt;
+vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr,
+		bool user UNUSED, bool write, bool not_present) {
+	struct supplemental_page_table *spt = &thread_current ()->leader->spt;
 	struct page *page = NULL;
-	/* TODO: Validate the fault */
-	/* TODO: Your code goes here */
+
+	if (addr == NULL || !is_user_vaddr (addr) || !not_present)
+		return false;
+	if (try_large_page (spt, addr, write))
+		return true;
+
+	lock_acquire (&spt->lock);
+	page = find_page (spt, addr);
+	if (page != NULL && is_large_page (page)) {
+		/* Part of a large page was unmapped.  Its 4 kB pages take
+		 * over, which maps the faulting one again. */
+		bool success = (!write || page->writable)
+			&& split_large_page (spt, page);
+
+		lock_release (&spt->lock);
+		return success;
+	}
+	lock_release (&spt->lock);
+	if (page == NULL || (write && !page->writable))
+		return false;
 
 	return vm_do_claim_page (page);
 }
 
+/* Backs the 2 MiB of anonymous memory at UPAGE, which must be
+ * aligned to LARGE_PAGE_SIZE and lie entirely in one region, with
+ * a single zeroed large page, if enough contiguous user memory is
+ * free.  Returns false if not, in which case the caller falls back
+ * to 4 kB pages.  The page fault handler calls this, through
+ * try_large_page(), for the first fault in an aligned 2 MiB of an
+ * anonymous VMA.  pml4_set_page() and pml4_clear_page() split the
+ * mapping by themselves when they change part of the range, and
+ * the next fault there splits the `struct page' too.  Swap-out
+ * must call split_large_page() before evicting part of it. */
+bool
+vm_map_huge_page (void *upage, bool writable) {
+	struct thread *leader = thread_current ()->leader;
+	void *kpage;
+
+	if ((uint64_t) upage % LARGE_PAGE_SIZE != 0)
+		return false;
+	kpage = palloc_get_multiple (PAL_USER | PAL_ZERO,
+			LARGE_PAGE_SIZE / PGSIZE);
+	if (kpage == NULL)
+		return false;
+	if (!pml4_set_large_page (leader->pml4, upage, kpage, writable)) {
+		palloc_free_multiple (kpage, LARGE_PAGE_SIZE / PGSIZE);
+		return false;
+	}
+	return true;
+}
+
 /* Free the page.
  * DO NOT MODIFY THIS FUNCTION. */
 void
@@ -150,10 +605,11 @@ vm_dealloc_page (struct page *page) {
 
 /* Claim the page that allocate on VA. */
 bool
-vm_claim_page (void *va UNUSED) {
-	struct page *page = NULL;
-	/* TODO: Fill this function */
+vm_claim_page (void *va) {
+	struct page *page = spt_find_page (&thread_current ()->leader->spt, va);
 
+	if (page == NULL)
+		return false;
 	return vm_do_claim_page (page);
 }
 
@@ -173,18 +629,118 @@ vm_do_claim_page (struct page *page) {
 
 /* Initialize new supplemental page table */
 void
-supplemental_page_table_init (struct supplemental_page_table *spt UNUSED) {
+supplemental_page_table_init (struct supplemental_page_table *spt) {
+	lock_init (&spt->lock);
+	if (!hash_init (&spt->pages, page_hash, page_less, NULL))
+		PANIC ("out of memory for supplemental page table");
+	tree_init (&spt->vmas, vma_less, NULL);
+}
+
+/* Copies large page SRC into DST, as a large page if one is
+ * available and as 4 kB pages otherwise.  DST's lock must be
+ * held. */
+static bool
+copy_large_page (struct supplemental_page_table *dst, struct page *src) {
+	const uint8_t *kva = src->frame->kva;
+	struct page *page;
+	size_t ofs;
+
+	page = map_large_page (dst, src->va, src->writable);
+	if (page != NULL) {
+		memcpy (page->frame->kva, kva, LARGE_PAGE_SIZE);
+		return true;
+	}
+
+	for (ofs = 0; ofs < LARGE_PAGE_SIZE; ofs += PGSIZE) {
+		page = new_page (dst, VM_ANON, (uint8_t *) src->va + ofs,
+				src->writable, NULL, NULL);
+		if (page == NULL || !vm_do_claim_page (page))
+			return false;
+		memcpy (page->frame->kva, kva + ofs, PGSIZE);
+	}
+	return true;
 }
 
-/* Copy supplemental page table from src to dst */
+/* Copy supplemental page table from src to dst.  Pages that have
+ * not been faulted in stay that way, sharing their initializer's
+ * aux with SRC, which is safe because initializers only read it.
+ * The others are copied into new frames.  On failure, empties
+ * DST again. */
 bool
-supplemental_page_table_copy (struct supplemental_page_table *dst UNUSED,
-		struct supplemental_page_table *src UNUSED) {
+supplemental_page_table_copy (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src) {
+	struct hash_iterator i;
+	struct tree_elem *e;
+
+	/* Other threads of SRC's process may fault while it is being
+	 * copied.  Nothing else can use DST yet. */
+	lock_acquire (&src->lock);
+	lock_acquire (&dst->lock);
+
+	/* SRC's VMAs do not overlap, so they all fit in DST. */
+	for (e = tree_first (&src->vmas); e != NULL; e = tree_next (e)) {
+		struct vma *vma = malloc (sizeof *vma);
+
+		if (vma == NULL)
+			goto fail;
+		*vma = *tree_entry (e, struct vma, elem);
+		tree_insert (&dst->vmas, &vma->elem);
+	}
+
+	hash_first (&i, &src->pages);
+	while (hash_next (&i)) {
+		struct page *src_page = hash_entry (hash_cur (&i), struct page, spt_elem);
+		struct page *page;
+
+		if (is_large_page (src_page)) {
+			if (!copy_large_page (dst, src_page))
+				goto fail;
+			continue;
+		}
+		if (VM_TYPE (src_page->operations->type) == VM_UNINIT) {
+			struct uninit_page *uninit = &src_page->uninit;
+
+			if (new_page (dst, uninit->type, src_page->va, src_page->writable,
+						uninit->init, uninit->aux) == NULL)
+				goto fail;
+			continue;
+		}
+
+		page = new_page (dst, page_get_type (src_page), src_page->va,
+				src_page->writable, NULL, NULL);
+		if (page == NULL || !vm_do_claim_page (page))
+			goto fail;
+		memcpy (page->frame->kva, src_page->frame->kva, PGSIZE);
+	}
+	lock_release (&dst->lock);
+	lock_release (&src->lock);
+	return true;
+
+fail:
+	lock_release (&dst->lock);
+	lock_release (&src->lock);
+	supplemental_page_table_kill (dst);
+	return false;
+}
+
+/* Frees a page in an spt's `pages'. */
+static void
+page_destructor (struct hash_elem *e, void *aux UNUSED) {
+	vm_dealloc_page (hash_entry (e, struct page, spt_elem));
 }
 
-/* Free the resource hold by the supplemental page table */
+/* Free the resource hold by the supplemental page table.  Leaves
+ * SPT empty but usable, since process_exec() loads the new image
+ * into the same table. */
 void
-supplemental_page_table_kill (struct supplemental_page_table *spt UNUSED) {
-	/* TODO: Destroy all the supplemental_page_table hold by thread and
-	 * TODO: writeback all the modified contents to the storage. */
+supplemental_page_table_kill (struct supplemental_page_table *spt) {
+	struct tree_elem *e;
+
+	lock_acquire (&spt->lock);
+	hash_clear (&spt->pages, page_destructor);
+	while ((e = tree_first (&spt->vmas)) != NULL) {
+		tree_remove (&spt->vmas, e);
+		free (tree_entry (e, struct vma, elem));
+	}
+	lock_release (&spt->lock);
 }